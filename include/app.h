@@ -9,6 +9,7 @@
 #include "SDL3/SDL_scancode.h"
 #include "SDL3/SDL_stdinc.h"
 #include "SDL3/SDL_video.h"
+#include "engine/pacing.h"
 #include "engine/scene.h"
 
 #define APPLICATION_NAME "Sakura and the Clow Cards"
@@ -19,6 +20,8 @@
 #define APPLICATION_ORIGINAL_HEIGHT 900
 
 #define APPLICATION_MAX_FPS 60
+#define APPLICATION_TARGET_FPS 60 // Rendering frame cap, 0 for uncapped.
+#define APPLICATION_VSYNC VSYNC_MODE_ADAPTIVE
 #define APPLICATION_SCALE 2
 #define APPLICATION_SHOW_FPS 1
 #define APPLICATION_SHOW_COLLIDERS 1
@@ -32,7 +35,7 @@
  */
 typedef struct
 {
-    Uint64 last_frame_tick; // When the last frame was rendered.
+    Uint64 last_frame_tick; // When the last frame was rendered, in ns.
     double frame_accum; // The amount of time accumulated before the next fixed
                         // update.
     Uint32 frame_count; // The counter for frames to display an uncapped FPS
@@ -55,9 +58,11 @@ typedef struct
  */
 typedef struct
 {
-    SDL_Renderer *renderer; // The renderer
-    SDL_Window *window;     // The window
-    int w, h;               // The window's height and width.
+    SDL_Renderer *renderer;   // The renderer
+    SDL_Window *window;       // The window
+    int w, h;                 // The window's height and width.
+    int logical_w, logical_h; // The size scenes are drawn at, which is the
+                              // window's size divided by APPLICATION_SCALE.
 } WindowStatus;
 
 /**
@@ -66,6 +71,7 @@ typedef struct
 typedef struct
 {
     FrameData frame_data;   // Frames data for calculating FPS and update ticks.
+    FramePacer pacer;       // The frame limiter.
     InputStatus input;      // The input status data for keyboard.
     WindowStatus window;    // The SDL's window.
     SceneManager scene_mgr; // Scene manager.
@@ -82,6 +88,18 @@ AppState *app_init(void);
  */
 AppState *app_get(void);
 
+/**
+ * Re-reads the window's output size, and recomputes the logical size that
+ * scenes are drawn at.
+ */
+void app_update_window_size(AppState *app);
+
+/**
+ * Destroys every scene in the scene manager. This runs before the engine is
+ * destroyed, as scenes hold on to fonts and assets the engine owns.
+ */
+void app_destroy_scenes(AppState *app);
+
 /**
  * Destroys the app state. This also frees up the AppState pointer itself.
  * Accessing the state after destroying is an undefined behavior.
@@ -92,6 +110,6 @@ void app_destroy(AppState *app);
  * Computes the path needed to retrieve a certain resource. Mostly done as MacOS
  * app bundles have a weird ass layout.
  *
- * The pointer returned is handled by the user, and should be freed.
+ * The path is written into `buf`. Returns false if it didn't fit.
  */
-char *app_res_path(const char *subpath);
+bool app_res_path(const char *subpath, char *buf, size_t size);
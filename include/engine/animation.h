@@ -0,0 +1,123 @@
+// engine/animation.h
+//
+// The animation system. This advances many sprite animations at once, so
+// animated tiles, particles and enemies can be stepped in a single pass every
+// tick, instead of one sprite at a time.
+
+#pragma once
+
+#include "SDL3/SDL_stdinc.h"
+#include "engine/sprite.h"
+#include <stdbool.h>
+
+/**
+ * Represents a handle to an animation within the system. A handle stays the
+ * same while the animation lives, even when others are removed. 0 is never a
+ * valid handle.
+ */
+typedef Uint32 AnimationId;
+
+/**
+ * Represents an animation that moved to another frame during a tick.
+ */
+typedef struct
+{
+    AnimationId id;
+    Uint32 frame_idx; // The new frame index, relative to the tag.
+} AnimationEvent;
+
+/**
+ * Represents the state of a single animation. These are kept packed together,
+ * so the tick only walks through memory in order.
+ */
+typedef struct
+{
+    const float *secs;  // The duration of each frame of the tag, in seconds.
+    float loop_secs;    // The duration of one loop through the tag.
+    float frame_accum;  // The time spent on the current frame, in seconds.
+    Uint32 num_frames;  // The number of frames in the tag.
+    Uint32 frame_idx;   // The current frame index, relative to the tag.
+    Uint32 first_frame; // The index of the tag's first frame in the sheet.
+    bool playing;       // Whether the animation is playing.
+} Animation;
+
+/**
+ * Represents the animation system.
+ */
+typedef struct
+{
+    // The animations, packed without holes, along with their sheets and
+    // handles at the same index.
+    Animation *anims;
+    SpriteSheet **sheets;
+    AnimationId *ids;
+    Uint32 num_anims;
+    Uint32 cap_anims;
+
+    // The index into the packed arrays for every handle, by handle - 1.
+    // Handles that were freed are reused.
+    Uint32 *slots;
+    Uint32 num_slots;
+    AnimationId *free_ids;
+    Uint32 num_free_ids;
+
+    // The frame changes of the last tick.
+    AnimationEvent *events;
+    Uint32 num_events;
+    Uint32 cap_events;
+} AnimationSystem;
+
+/**
+ * Initializes an empty animation system.
+ */
+AnimationSystem *animation_system_init(void);
+
+/**
+ * Adds an animation that plays a tag of a sheet, or the whole sheet if the
+ * tag is -1. The system holds a reference to the sheet while the animation
+ * lives. The animation starts paused.
+ *
+ * Returns 0 if the animation couldn't be added.
+ */
+AnimationId animation_system_add(AnimationSystem *sys, SpriteSheet *sheet,
+                                 int tag);
+
+/**
+ * Removes an animation, and releases its sheet.
+ */
+void animation_system_remove(AnimationSystem *sys, AnimationId id);
+
+/**
+ * Changes the tag an animation plays, and resets it to the first frame.
+ */
+bool animation_system_set_tag(AnimationSystem *sys, AnimationId id, int tag);
+
+/**
+ * Plays or pauses an animation.
+ */
+void animation_system_set_playing(AnimationSystem *sys, AnimationId id,
+                                  bool playing);
+
+/**
+ * Retrieves the frame an animation is currently on, or NULL if there is no
+ * such animation.
+ */
+const SpriteFrame *animation_system_frame(AnimationSystem *sys,
+                                          AnimationId id);
+
+/**
+ * Advances every playing animation by a deltatime amount. The frame changes
+ * can be read with `animation_system_events` until the next tick.
+ */
+void animation_system_tick(AnimationSystem *sys, double dt);
+
+/**
+ * Retrieves the frame changes of the last tick.
+ */
+const AnimationEvent *animation_system_events(AnimationSystem *sys,
+                                              Uint32 *count);
+
+/**
+ * Destroys the animation system, and releases every sheet it holds.
+ */
+void animation_system_destroy(AnimationSystem *sys);
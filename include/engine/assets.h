@@ -0,0 +1,103 @@
+// engine/assets.h
+//
+// The asset registry. Assets are loaded once by their type and name, and
+// shared between everyone that asks for them. An asset is unloaded when its
+// last user releases it.
+
+#pragma once
+
+#include "SDL3/SDL_stdinc.h"
+#include "engine/map.h"
+#include "engine/sprite.h"
+#include <stdbool.h>
+
+/**
+ * Represents the type of an asset.
+ */
+typedef enum
+{
+    ASSET_TYPE_SPRITE, // A sprite sheet, from assets/spr.
+    ASSET_TYPE_MAP,    // A level's map, from assets/map.
+} AssetType;
+
+/**
+ * Represents an asset to be loaded, used for preload lists.
+ */
+typedef struct
+{
+    AssetType type;
+    const char *name;
+} AssetRef;
+
+/**
+ * Initializes the asset registry.
+ */
+bool assets_init(void);
+
+/**
+ * Retrieves an asset, loading it if no one holds it yet. Every successful
+ * acquire must be paired with a release.
+ *
+ * Returns NULL if the asset couldn't be loaded.
+ */
+void *assets_acquire(AssetType type, const char *name);
+
+/**
+ * Acquires an asset only if it's loaded already, without touching the disk.
+ *
+ * Returns false if no one holds the asset.
+ */
+bool assets_hold(AssetType type, const char *name);
+
+/**
+ * Hands an asset loaded elsewhere, like by the asynchronous loader, over to
+ * the registry, and acquires it. If the asset got loaded in the meantime, the
+ * given data is unloaded and the registry's copy is used instead.
+ *
+ * Returns the asset the registry holds.
+ */
+void *assets_adopt(AssetType type, const char *name, void *data);
+
+/**
+ * Retrieves a sprite sheet. The sheet stays valid until it's released, make
+ * sprites with `sprite_init_shared` to keep it for longer.
+ */
+SpriteSheet *assets_acquire_sprite(const char *name);
+
+/**
+ * Retrieves a map. The map stays valid until it's released.
+ */
+Map *assets_acquire_map(const char *name);
+
+/**
+ * Releases an asset. The asset is unloaded when no one holds it anymore.
+ */
+void assets_release(AssetType type, const char *name);
+
+/**
+ * Acquires every asset in a list. Either every asset is acquired, or none is.
+ *
+ * Returns false if any of the assets couldn't be loaded.
+ */
+bool assets_preload(const AssetRef *refs, Uint32 count);
+
+/**
+ * Releases every asset in a list, that was acquired with `assets_preload`.
+ */
+void assets_release_list(const AssetRef *refs, Uint32 count);
+
+/**
+ * Builds the path of an asset's file, relative to the working directory.
+ */
+void assets_get_path(AssetType type, const char *name, char *buf, size_t size);
+
+/**
+ * Unloads an asset's data that the registry does not hold, like the result of
+ * an asynchronous load that was never used.
+ */
+void assets_free_data(AssetType type, void *data);
+
+/**
+ * Destroys the asset registry, and unloads every asset still held.
+ */
+void assets_destroy(void);
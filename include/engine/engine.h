@@ -28,6 +28,11 @@ void engine_iterate(AppState *app);
  */
 void engine_render(AppState *app);
 
+/**
+ * Called after rendering, waits until the next frame should start.
+ */
+void engine_wait_frame(AppState *app);
+
 /**
  * Destroys the game engine and shuts down all components.
  */
@@ -0,0 +1,93 @@
+// engine/loader.h
+//
+// The asynchronous asset loader. Files are read in the background, decoded on
+// worker threads, and their textures are uploaded on the main thread a little
+// every frame, so loading never freezes rendering.
+
+#pragma once
+
+#include "SDL3/SDL_atomic.h"
+#include "SDL3/SDL_stdinc.h"
+#include "engine/assets.h"
+#include <stdbool.h>
+
+// How long the loader may spend on the main thread every frame.
+#define LOADER_FRAME_BUDGET_NS (2 * SDL_NS_PER_MS)
+
+// How many rows of a texture are uploaded at once.
+#define LOADER_UPLOAD_ROWS 64
+
+/**
+ * Represents the stage a load request is at.
+ */
+typedef enum
+{
+    LOAD_STATE_READING,   // The file is being read.
+    LOAD_STATE_DECODING,  // The file is waiting for, or on a worker thread.
+    LOAD_STATE_UPLOADING, // The texture is being uploaded on the main thread.
+    LOAD_STATE_DONE,      // The asset is ready to be taken.
+    LOAD_STATE_FAILED,    // The asset couldn't be loaded.
+} LoadState;
+
+/**
+ * Represents a handle to an asset being loaded. Handles are created by
+ * `loader_request`, and must be given back with `loader_release`.
+ */
+typedef struct
+{
+    AssetType type;
+    char *name;
+    SDL_AtomicInt state; // The LoadState. Read it with `loader_get_state`.
+
+    void *file_data; // The file's content, until the asset is fully loaded.
+    size_t file_size;
+    bool file_owned; // Whether the content was read, or lives in the pack.
+    void *result; // The decoded asset.
+
+    bool released; // Whether the caller gave the handle back early.
+} LoadRequest;
+
+/**
+ * Initializes the loader and its worker threads.
+ */
+bool loader_init(void);
+
+/**
+ * Starts loading an asset in the background.
+ *
+ * Returns NULL if the load couldn't be started.
+ */
+LoadRequest *loader_request(AssetType type, const char *name);
+
+/**
+ * Retrieves the stage a request is at.
+ */
+LoadState loader_get_state(LoadRequest *req);
+
+/**
+ * Checks if a request is finished, whether it succeeded or not.
+ */
+bool loader_is_finished(LoadRequest *req);
+
+/**
+ * Takes the loaded asset out of a finished request. The caller owns the asset
+ * afterwards. Returns NULL if the request failed, or is not done yet.
+ */
+void *loader_take_result(LoadRequest *req);
+
+/**
+ * Gives a request back. An asset that wasn't taken is unloaded. If the request
+ * is still loading, it's cleaned up once it finishes.
+ */
+void loader_release(LoadRequest *req);
+
+/**
+ * Moves finished reads to the worker threads, and uploads decoded textures
+ * until the time budget runs out. Call this once a frame, on the main thread.
+ */
+void loader_update(Uint64 budget_ns);
+
+/**
+ * Destroys the loader. This waits for the reads and decodes in progress.
+ */
+void loader_destroy(void);
@@ -6,6 +6,20 @@
 
 #include "SDL3/SDL_stdinc.h"
 #include "engine/sprite.h"
+#include "misc/hashmap.h"
+
+// Tiles per side of a map chunk. Maps are stored, streamed and autotiled chunk
+// by chunk.
+#define MAP_CHUNK_SIZE 32
+
+// How many chunks a streamed map keeps resident around its focus, in every
+// direction, and how many more it loads ahead in the direction of travel.
+#define MAP_STREAM_RADIUS 2
+#define MAP_STREAM_LOOKAHEAD 2
+
+// The most chunks a streamed map keeps resident at once. This must hold the
+// square around the focus, with the look ahead on both axes.
+#define MAP_STREAM_BUDGET 64
 
 #define NODE_DIR_N (1 << 0)
 #define NODE_DIR_S (1 << 1)
@@ -37,6 +51,8 @@ typedef enum
 {
     TILE_AIR = 0,
     TILE_WOOD,
+
+    NUM_MAP_TILES,
 } MapTile;
 
 /**
@@ -49,27 +65,154 @@ typedef struct
 } MapNode;
 
 /**
- * Represents a level's map.
+ * Represents a node of the map as stored, packed into a byte. The tile is in
+ * the high nibble, and the direction bit mask in the low nibble.
+ */
+typedef Uint8 MapCell;
+
+#define MAP_CELL(tile, dir) ((MapCell)(((tile) << 4) | (dir)))
+#define MAP_CELL_TILE(cell) ((MapTile)((cell) >> 4))
+#define MAP_CELL_DIR(cell) ((int)((cell) & 0xF))
+
+/**
+ * Represents a square of tiles of a map.
+ */
+typedef struct
+{
+    MapCell cells[MAP_CHUNK_SIZE * MAP_CHUNK_SIZE]; // Row by row.
+    Uint32 cx, cy;    // Where the chunk is in the map, in chunks.
+    Uint32 slot;      // Where the chunk is in the map's chunk list.
+    Uint32 num_tiles; // How many of the cells are not air.
+    Uint64 last_used; // The stream update that last wanted the chunk.
+} MapChunk;
+
+/**
+ * Represents a rectangle of tiles, of `w` by `h` tiles from (x, y).
  */
 typedef struct
+{
+    Uint32 x;
+    Uint32 y;
+    Uint32 w;
+    Uint32 h;
+} MapRegion;
+
+/**
+ * Called when tiles of a map changed, with the region where tiles or their
+ * direction bit masks are different. Render caches and collision structures
+ * listen to this to rebuild only what changed.
+ */
+struct Map;
+typedef void (*MapListener)(struct Map *map, MapRegion region, void *userdata);
+
+/**
+ * Represents a listener added to a map, and what it's called with.
+ */
+typedef struct
+{
+    MapListener callback;
+    void *userdata;
+} MapListenerEntry;
+
+/**
+ * Represents a level's map. Only the chunks with anything else than air are
+ * in memory, most of a level is usually sky.
+ */
+typedef struct Map
 {
     char *name;
     Uint32 w;
     Uint32 h;
-    MapNode *tiles;
+    Uint32 chunks_w; // The size of the map, in chunks.
+    Uint32 chunks_h;
+    HashMap *chunks; // The chunks in memory, by their chunk coordinate. A
+                     // chunk that is not there is air, or not streamed in.
+    MapChunk **chunk_list; // The same chunks, to go through all of them.
+    Uint32 num_chunks;
+    Uint32 cap_chunks;
+    struct MapStream *stream; // NULL if the whole map is loaded.
+
+    MapListenerEntry *listeners; // Who is told about changed tiles.
+    Uint32 num_listeners;
+    Uint32 cap_listeners;
 } Map;
 
 /**
  * Initializes a map from a provided .map file.
+ *
+ * This always reads the file, it's the asset registry's loader. Use
+ * `assets_acquire_map` to share maps instead.
  */
 Map *map_init(const char *name);
 
 /**
- * Sets the tile used for the map.
+ * Decodes a map from a .map file that is already in memory. This can run on
+ * any thread.
+ */
+Map *map_decode(const void *data, size_t size, const char *name);
+
+/**
+ * Opens a map for streaming. Only the chunk index is read here, chunks are
+ * loaded and unloaded around a focus by `map_stream_update`. Maps that can't
+ * be streamed, as they're not version 2 or have another chunk size, are
+ * loaded whole instead.
+ *
+ * Streamed maps are not shared through the asset registry.
+ */
+Map *map_stream_open(const char *name);
+
+/**
+ * Moves a streamed map's focus, like the player, in tiles. Finished reads are
+ * decoded, chunks around the focus and ahead of it are requested, and the
+ * ones furthest behind are unloaded past `MAP_STREAM_BUDGET`. Call this once a
+ * frame. Nothing happens for maps that are fully loaded.
+ */
+void map_stream_update(Map *map, double x, double y);
+
+/**
+ * Retrieves a chunk of the map by its chunk coordinate. Returns NULL if it's
+ * only air, not streamed in, or outside of the map.
+ */
+MapChunk *map_get_chunk(const Map *map, Sint64 cx, Sint64 cy);
+
+/**
+ * Retrieves the node at a tile, across chunk borders. Tiles outside of the
+ * map, or in chunks that are not resident, are air.
+ */
+MapNode map_get_node(const Map *map, Sint64 x, Sint64 y);
+
+/**
+ * Changes a tile at runtime, like a block breaking. Only the direction bit
+ * masks of the tile and of the 4 around it are recomputed, and the listeners
+ * are told about that 3x3 region.
+ *
+ * Edits to a streamed map are lost once their chunk is unloaded. Tiles of a
+ * streamed chunk can only be edited once it's loaded, as reading it in would
+ * overwrite them.
+ *
+ * Returns false if the tile is outside of the map, not a known tile, or in a
+ * streamed chunk that is not loaded yet.
+ */
+bool map_set_tile(Map *map, Uint32 x, Uint32 y, MapTile tile);
+
+/**
+ * Adds a listener that is called whenever tiles of the map change, by
+ * `map_set_tile`, or by chunks of a streamed map coming in or leaving.
+ */
+void map_add_listener(Map *map, MapListener callback, void *userdata);
+
+/**
+ * Removes a listener added with the same callback and userdata.
+ */
+void map_remove_listener(Map *map, MapListener callback, void *userdata);
+
+/**
+ * Finds the sheet's frame tag that draws a tile, or -1 if there is none.
  */
-void map_tile_sprite(Sprite *spr, MapTile tile);
+int map_tile_tag(const SpriteSheet *sheet, MapTile tile);
 
 /**
- * Destroys all memory used by the map.
+ * Destroys all memory used by the map. This waits for the reads of a streamed
+ * map in progress.
  */
 void map_destroy(Map *map);
@@ -0,0 +1,58 @@
+// engine/pacing.h
+//
+// The frame pacing part of the engine. This decides how long the app waits
+// between two rendered frames, and how the renderer syncs with the display.
+
+#pragma once
+
+#include "SDL3/SDL_render.h"
+#include "SDL3/SDL_stdinc.h"
+
+/**
+ * Represents how the renderer should sync its presents with the display.
+ */
+typedef enum
+{
+    VSYNC_MODE_OFF,      // Present as soon as a frame is ready.
+    VSYNC_MODE_ON,       // Wait for every vertical blank.
+    VSYNC_MODE_ADAPTIVE, // Wait for vertical blanks, unless we're late.
+} VsyncMode;
+
+/**
+ * Represents the frame limiter's state.
+ */
+typedef struct
+{
+    Uint64 frame_ns;      // The target duration of a frame. 0 is uncapped.
+    Uint64 next_frame_ns; // The timestamp the next frame should start at.
+    Uint64 spin_ns;       // How much of the wait is spent busy-waiting, as
+                          // sleeping is only accurate to about a millisecond.
+    VsyncMode vsync;      // The vsync mode that is actually applied.
+} FramePacer;
+
+/**
+ * Initializes the frame limiter with a target frame rate. A rate of 0 means
+ * the frames are not capped.
+ */
+void frame_pacer_init(FramePacer *pacer, Uint32 fps);
+
+/**
+ * Changes the target frame rate of the frame limiter. A rate of 0 means the
+ * frames are not capped.
+ */
+void frame_pacer_set_target_fps(FramePacer *pacer, Uint32 fps);
+
+/**
+ * Applies a vsync mode to the renderer. If adaptive vsync is not supported,
+ * this falls back to normal vsync.
+ *
+ * Returns false if the renderer refused every mode it was given.
+ */
+bool frame_pacer_set_vsync(FramePacer *pacer, SDL_Renderer *renderer,
+                           VsyncMode mode);
+
+/**
+ * Blocks until the next frame should start. This sleeps for most of the
+ * interval, and busy-waits for the last fraction to hit the deadline exactly.
+ */
+void frame_pacer_wait(FramePacer *pacer);
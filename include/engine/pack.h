@@ -0,0 +1,43 @@
+// engine/pack.h
+//
+// The asset pack. Every asset file is bundled into a single pack file with a
+// sorted table of contents, built by tools/pack_assets.py. The pack is mapped
+// into memory once, and assets are read straight out of it.
+
+#pragma once
+
+#include "SDL3/SDL_stdinc.h"
+#include <stdbool.h>
+
+// The name of the pack file, next to the executable.
+#define PACK_FILE_NAME "assets.pack"
+
+/**
+ * Opens and maps the asset pack. Without a pack, assets are read from the
+ * loose files instead.
+ *
+ * Returns false if there is no usable pack.
+ */
+bool pack_open(const char *path);
+
+/**
+ * Finds a file in the pack by its path, like "assets/spr/tile.sprite". The
+ * memory belongs to the pack, and stays valid until it's closed.
+ *
+ * Returns NULL if the pack is not open, or doesn't have the file.
+ */
+const void *pack_get(const char *path, size_t *size);
+
+/**
+ * Reads a file, out of the pack if it's there, or from the disk otherwise.
+ * `owned` tells whether the caller has to SDL_free the memory, as files in
+ * the pack are not copied.
+ *
+ * Returns NULL if the file couldn't be found anywhere.
+ */
+void *pack_read(const char *path, size_t *size, bool *owned);
+
+/**
+ * Unmaps the asset pack. Memory from the pack can't be used afterwards.
+ */
+void pack_close(void);
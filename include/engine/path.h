@@ -0,0 +1,116 @@
+// engine/path.h
+//
+// Finds paths over a map's tiles, for enemies and companions to navigate. Air
+// is open and every other tile is solid. Agents move in 8 directions, but
+// never diagonally past a solid tile.
+//
+// Searches use A* with jump point search. Long routes go through a graph of
+// the map's chunks instead, and found paths are cached until the tiles they
+// cross are edited.
+
+#pragma once
+
+#include "SDL3/SDL_rect.h"
+#include "SDL3/SDL_stdinc.h"
+#include "engine/map.h"
+
+// The cost of moving a tile straight, and diagonally.
+#define PATH_COST_STRAIGHT 10
+#define PATH_COST_DIAGONAL 14
+
+// How far apart, in straight moves, the start and the goal can be to be
+// searched directly. Further routes use the chunk graph, when enabled.
+#define PATH_DIRECT_RANGE (2 * MAP_CHUNK_SIZE)
+
+// How many paths are cached.
+#define PATH_CACHE_SIZE 64
+
+// How long path requests may be searched for every tick.
+#define PATH_TICK_BUDGET_NS (1 * SDL_NS_PER_MS)
+
+/**
+ * Represents a path, from the start to the goal. Consecutive points are on a
+ * straight or diagonal line, so agents can walk from one to the next.
+ */
+typedef struct
+{
+    SDL_Point *points;
+    Uint32 length;
+    Uint32 capacity;
+    Uint32 cost; // In PATH_COST_STRAIGHT per tile.
+} Path;
+
+/**
+ * Represents the outcome of a search.
+ */
+typedef enum
+{
+    PATH_STATE_IDLE,      // The request was never submitted.
+    PATH_STATE_PENDING,   // The request is waiting for its turn.
+    PATH_STATE_FOUND,     // The path is ready.
+    PATH_STATE_NOT_FOUND, // The goal can't be reached.
+} PathState;
+
+/**
+ * Represents a path an agent asked for. Agents own their request, and submit
+ * it again to replan. The path's points are reused between searches.
+ */
+typedef struct
+{
+    SDL_Point start;
+    SDL_Point goal;
+    PathState state;
+    Path path;
+    bool queued; // Whether the request is in the pathfinder's queue.
+} PathRequest;
+
+/**
+ * Represents the pathfinder of a map. Its definition is in path.c.
+ */
+typedef struct Pathfinder Pathfinder;
+
+/**
+ * Initializes a pathfinder over a map. It listens to the map's tile changes,
+ * so the map must outlive it.
+ *
+ * With `clusters`, routes longer than PATH_DIRECT_RANGE are found over a graph
+ * of the map's chunks, which is much faster but can be a little longer than
+ * the shortest path.
+ */
+Pathfinder *pathfinder_init(Map *map, bool clusters);
+
+/**
+ * Finds a path right away. Paths are looked up in the cache first. The path's
+ * points are reused, and grown when needed.
+ */
+PathState pathfinder_find(Pathfinder *pf, SDL_Point start, SDL_Point goal,
+                          Path *path);
+
+/**
+ * Queues a request to be searched by `pathfinder_update`. Submitting a queued
+ * request again only updates its start and goal.
+ */
+void pathfinder_submit(Pathfinder *pf, PathRequest *req);
+
+/**
+ * Takes a request out of the queue. This must be done before freeing a
+ * request that is still pending.
+ */
+void pathfinder_cancel(Pathfinder *pf, PathRequest *req);
+
+/**
+ * Searches the queued requests, in the order they were submitted, until the
+ * time budget runs out. Call this once a tick.
+ */
+void pathfinder_update(Pathfinder *pf, Uint64 budget_ns);
+
+/**
+ * Frees the points of a path.
+ */
+void path_free(Path *path);
+
+/**
+ * Destroys a pathfinder, and stops listening to its map. Requests still in
+ * the queue are left pending.
+ */
+void pathfinder_destroy(Pathfinder *pf);
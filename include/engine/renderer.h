@@ -44,7 +44,7 @@ void render_aligned_texture(RenderingOptions options);
 /**
  * Renders a map with the provided sprite sheet.
  */
-void render_map(Map *map, Sprite *spr);
+void render_map(Map *map, SpriteSheet *sheet);
 
 /**
  * Renders a sprite into the screen, at the exact center of the provided
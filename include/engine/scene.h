@@ -7,11 +7,22 @@
 #include "SDL3/SDL_pixels.h"
 #include "SDL3/SDL_rect.h"
 #include "SDL3/SDL_render.h"
+#include "engine/assets.h"
+#include "engine/loader.h"
 #include "engine/signal.h"
+#include "engine/target_pool.h"
+#include "misc/array.h"
 #include "misc/hashmap.h"
 #include "misc/list.h"
 #include "misc/stack.h"
 
+// How long a scene may take to load, in seconds, before the loading scene is
+// shown on top of everything.
+#define SCENE_LOADING_DELAY 0.25
+
+// How many transitions the scene manager holds before it allocates.
+#define SCENE_MGR_INLINE_TRANSITIONS 4
+
 /**
  * Represents the enumeration type IDs for various scene types.
  */
@@ -33,6 +44,7 @@ typedef struct
 {
     SDL_Color color;
     SDL_FRect frect;
+    bool fills_screen; // Whether frect follows the logical resolution.
 } SceneEmpty;
 
 /**
@@ -41,8 +53,20 @@ typedef struct
 typedef struct
 {
     SDL_Color color;
+    Uint32 shown_fps;        // The FPS value that is currently on screen.
+    struct TextLabel *label; // The label that shows the value.
+    Sprite *mascot;          // Plays in the corner, to show the game runs.
 } SceneFPS;
 
+/**
+ * Represents internal data for the loading scene.
+ */
+typedef struct
+{
+    SDL_Color color;
+    float progress; // How much of the scenes being loaded is loaded, 0 to 1.
+} SceneLoading;
+
 /**
  * Represents a scene in the game.
  */
@@ -60,6 +84,16 @@ typedef struct Scene
     // For each frame it is loaded, ontick is called.
     // For each engine physical frame is run, onphystick is called.
     // When the scene is unloaded, ondestroy is called.
+    //
+    // ondraw draws straight into the shared canvas, on top of the scenes
+    // below, so it must not clear the render target.
+    //
+    // ondraw is only called when something on screen changed. A scene that
+    // changes how it looks from ontick, onphystick or onsignal should call
+    // `scene_mark_dirty`, otherwise the last drawn frame stays on screen.
+    //
+    // onresize is called when the logical resolution changes, so scenes that
+    // follow the screen's size, or are opaque, can update themselves.
     void (*oninit)(struct Scene *scene);
     void (*onstart)(struct Scene *scene);
     void (*ontick)(struct Scene *scene, double dt);
@@ -67,6 +101,7 @@ typedef struct Scene
     void (*onphystick)(struct Scene *scene);
     void (*onsignal)(struct Scene *scene, Signal *signal);
     void (*ondestroy)(struct Scene *scene);
+    void (*onresize)(struct Scene *scene, int w, int h);
 
     // The scene's own colliders and sprites. These are handled by the callers,
     // scene destruction won't destroy those, as these can be reused by other
@@ -74,6 +109,13 @@ typedef struct Scene
     HashMap *colliders;
     HashMap *sprites;
 
+    // The assets the scene needs, acquired before `oninit` is called and
+    // released when the scene is destroyed. Assets another scene already
+    // holds, like the one it transitions from, are not loaded again.
+    const AssetRef *assets;
+    Uint32 num_assets;
+    bool assets_held; // Whether the assets above were acquired.
+
     // Scene's flags.
     //
     // enabled
@@ -92,16 +134,33 @@ typedef struct Scene
     // stops_propagation
     // -- If false, this does nothing.
     // -- If true, all scenes below don't get signals passed to them.
+    //
+    // opaque
+    // -- If false, this does nothing.
+    // -- If true, the scene covers the whole screen with opaque pixels. Scenes
+    // below this in the stack are hidden, so they don't get drawn, and don't
+    // have tick called. Phystick still follows `captures_focus`.
+    //
+    // dirty
+    // -- If false, the scene looks the same as the last time it was drawn.
+    // -- If true, the scene needs to be drawn again on the next frame.
     bool enabled;
     bool accepting_signals;
     bool captures_focus;
     bool stops_propagation;
+    bool opaque;
+    bool dirty;
+
+    // The alpha the scene is drawn with as a whole, from 0 to 1. A scene below
+    // 1 is drawn offscreen first, which costs a full-screen pass.
+    float opacity;
 
     // The scene's private data
     union SceneData
     {
         SceneEmpty empty;
         SceneFPS fps;
+        SceneLoading loading;
     } data;
 } Scene;
 
@@ -133,22 +192,48 @@ typedef struct
 
     bool active;
     bool destroys_after; // Whether to destroy from_scene after transitioning.
-    bool stops_physics;  // Whether to stop physics during transitioning.
+    bool stops_physics;  // Whether to stop physics during transitioning. The
+                         // from_scene gets no ticks, and is drawn only once.
     bool stops_signals; // Whether to stop passing signals during transitioning.
 
-    // Rendering primitives.
+    // Rendering primitives, borrowed from the scene manager's target pool.
     SDL_Texture *from_txt;
     SDL_Texture *to_txt;
+    bool from_captured; // Whether from_txt already holds the from_scene.
 } SceneTransition;
 
+/**
+ * Represents a transition waiting for its to_scene's assets to be loaded in
+ * the background.
+ */
+typedef struct
+{
+    SceneTransition transition;
+    LoadRequest **requests; // One per asset of the scene, NULL if not loading.
+    bool *held;             // Whether each asset is acquired already.
+    Uint32 num_pending;     // How many requests are not finished yet.
+    double elapsed;         // How long the scene has been loading, in seconds.
+    bool failed;            // Whether any asset couldn't be loaded.
+} ScenePreparation;
+
 /**
  * Represents the manager of scene.
  */
 typedef struct
 {
     Stack *scenes;
-    List *transitions;
-    SDL_Texture *target;
+    SMALL_ARRAY(SceneTransition, SCENE_MGR_INLINE_TRANSITIONS) transitions;
+    List *preparing; // The transitions whose scenes are still loading.
+    Scene *loading;  // Shown while scenes take long to load, owned by the
+                     // scene manager. NULL to never show anything.
+    SDL_Texture *canvas; // The logical resolution texture scenes compose into,
+                         // upscaled to the window when presenting.
+    SDL_Texture *target; // The offscreen texture a single scene draws into.
+    SDL_Texture *snapshot; // The paused scenes below the one capturing focus,
+                           // drawn once and reused while they stay frozen.
+    Scene *snapshot_focus; // The scene capturing focus above the snapshot.
+    RenderTargetPool *targets; // Where every texture above comes from.
+    bool dirty; // Whether the stack itself changed since the last draw.
 } SceneManager;
 
 /**
@@ -162,6 +247,19 @@ Scene *scene_init(void);
  */
 void scene_destroy(Scene *scene);
 
+/**
+ * Marks the scene as changed, so the scene manager redraws on the next frame.
+ */
+void scene_mark_dirty(Scene *scene);
+
+/**
+ * Acquires the scene's assets, if it hasn't yet. The scene manager does this
+ * before a scene is initialized.
+ *
+ * Returns false if any asset couldn't be loaded.
+ */
+bool scene_acquire_assets(Scene *scene);
+
 /**
  * Ticks the scene manager at a variable rate.
  */
@@ -169,7 +267,8 @@ void scene_mgr_tick(SceneManager *mgr, double dt);
 
 /**
  * Pushes a scene unconditionally to the stack. This returns false if the stack
- * is full. This is mainly used to setup starting scenes that do not need
+ * is full, or if the scene's assets couldn't be loaded, in which case the scene
+ * is destroyed. This is mainly used to setup starting scenes that do not need
  * transitions.
  */
 bool scene_mgr_push_scene(SceneManager *mgr, Scene *scene);
@@ -177,11 +276,22 @@ bool scene_mgr_push_scene(SceneManager *mgr, Scene *scene);
 /**
  * Starts a new transition from a scene to another.
  *
+ * The to_scene's assets are loaded in the background first, and the
+ * transition only starts, with `oninit` called, once they're all resident.
+ * If that takes longer than `SCENE_LOADING_DELAY`, the loading scene is shown
+ * meanwhile. A to_scene whose assets can't be loaded is destroyed.
+ *
  * The caller should not allocate any transitions and let the scene manager
  * handle it.
  */
 void scene_mgr_start_transition(SceneManager *mgr, SceneTransition transition);
 
+/**
+ * Drops every transition still waiting for its assets, destroying their
+ * to_scene, and hides the loading scene.
+ */
+void scene_mgr_cancel_preparations(SceneManager *mgr);
+
 /**
  * Ticks the scene manager physically. Only at a rate of 16ms per tick.
  */
@@ -194,6 +304,26 @@ void scene_mgr_phys_tick(SceneManager *mgr);
 void scene_mgr_on_signal(SceneManager *mgr, Signal *signal);
 
 /**
- * Renders the current scene manager.
+ * (Re)creates the scene manager's textures at the logical resolution, and
+ * tells every scene it holds about the new size. Nothing is reallocated if the
+ * logical resolution is the same. Returns false if the textures couldn't be
+ * created.
+ */
+bool scene_mgr_resize(SceneManager *mgr, int w, int h);
+
+/**
+ * Marks the whole scene manager as changed, for example when the window is
+ * resized or uncovered, so everything is redrawn on the next frame.
+ */
+void scene_mgr_mark_dirty(SceneManager *mgr);
+
+/**
+ * Checks if any scene changed since the last draw, or if a transition is
+ * running. If not, the last frame is still valid and drawing can be skipped.
+ */
+bool scene_mgr_needs_redraw(SceneManager *mgr);
+
+/**
+ * Renders the current scene manager. This clears the dirty flags.
  */
 void scene_mgr_draw(SceneManager *mgr);
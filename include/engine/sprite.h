@@ -6,6 +6,7 @@
 
 #include "SDL3/SDL_rect.h"
 #include "SDL3/SDL_render.h"
+#include "SDL3/SDL_surface.h"
 #include "misc/vector.h"
 #include <stdbool.h>
 
@@ -30,12 +31,13 @@ typedef struct
     char *tag;
     Uint32 from;
     Uint32 to;
+    float secs; // The duration of one loop through the tag, in seconds.
 } FrameTag;
 
 /**
- * Represents a Sprite. A sprite can be animated or not (determined by the `fps`
- * field). A sprite also has frames, where each frame determines the source
- * rectangle WITHIN the frame.
+ * Represents a sprite sheet. This is the data loaded from a sprite asset, and
+ * is never changed after loading, so many sprites can share one. A sheet is
+ * reference counted, and is destroyed when its last user releases it.
  */
 typedef struct
 {
@@ -44,21 +46,149 @@ typedef struct
     SpriteFrame *frames;  // The sprite's frames.
     Uint32 num_frames;    // The number of frames.
     Vector2 size;         // The size of the sprite sheet as a whole.
+    float *frame_secs;    // The duration of each frame, in seconds.
+    float secs;           // The duration of all frames, in seconds.
     FrameTag *tags;       // The sprite's frame tags.
     Uint32 num_tags;      // The number of tags.
+    Uint32 refs;          // The number of users holding the sheet.
 
-    bool playing;       // Whether the sprite is playing.
-    int sel_tag;        // The frame tag that is currently being chosen.
-    Uint32 frame_idx;   // The current frame index of the sprite.
-    double frame_accum; // The accumulator for frames to decide when we should
-                        // move on to next frame.
+    // The pixels that are not on the texture yet, and how many of their rows
+    // were uploaded. See `sprite_sheet_upload`.
+    SDL_Surface *pending;
+    int uploaded_rows;
+} SpriteSheet;
+
+/**
+ * Represents the playback state of an animation on a sprite sheet. The tag is
+ * an index into the sheet's tags, or -1 to play every frame.
+ */
+typedef struct
+{
+    bool playing;       // Whether the animation is playing.
+    int tag;            // The frame tag that is currently being chosen.
+    Uint32 frame_idx;   // The current frame index, relative to the tag.
+    float frame_accum;  // The time spent on the current frame, in seconds.
+} SpriteAnimator;
+
+/**
+ * Represents a Sprite. A sprite is an instance of a shared sprite sheet, with
+ * its own animation state.
+ */
+typedef struct
+{
+    SpriteSheet *sheet;
+    SpriteAnimator anim;
+    char *asset; // The name the sheet was acquired by, NULL if it's shared.
 } Sprite;
 
 /**
- * Loads a sprite from a sprite asset.
+ * Loads a sprite sheet from a sprite asset. The sheet starts with one
+ * reference, owned by the caller.
+ *
+ * This always reads the file, it's the asset registry's loader. Use
+ * `assets_acquire_sprite` or `sprite_init` to share sheets instead.
+ */
+SpriteSheet *sprite_sheet_init(const char *sprite);
+
+/**
+ * Decodes a sprite sheet from a sprite asset that is already in memory, and
+ * uploads its texture. The memory is not needed after this returns.
+ */
+SpriteSheet *sprite_sheet_decode(const void *data, size_t size);
+
+/**
+ * Decodes a sprite sheet from a sprite asset that is already in memory,
+ * without creating its texture. This doesn't touch the renderer, so it can
+ * run on any thread. The pending pixels may point into `data`, so the memory
+ * must be kept until the sheet is fully uploaded.
+ */
+SpriteSheet *sprite_sheet_parse(const void *data, size_t size);
+
+/**
+ * Uploads up to `max_rows` rows of a parsed sheet's pixels to its texture,
+ * creating the texture first if needed. A `max_rows` of 0 uploads everything.
+ * This must run on the main thread.
+ *
+ * Returns true when the whole sheet is uploaded.
+ */
+bool sprite_sheet_upload(SpriteSheet *sheet, SDL_Renderer *renderer,
+                         int max_rows);
+
+/**
+ * Adds a reference to a sprite sheet, and returns it.
+ */
+SpriteSheet *sprite_sheet_ref(SpriteSheet *sheet);
+
+/**
+ * Removes a reference from a sprite sheet. The sheet is destroyed when there
+ * are no references left.
+ */
+void sprite_sheet_release(SpriteSheet *sheet);
+
+/**
+ * Finds the index of a frame tag by its name. Resolve the names once and keep
+ * the index around, as this compares strings.
+ *
+ * Returns -1 if there is no such tag.
+ */
+int sprite_sheet_find_tag(const SpriteSheet *sheet, const char *name);
+
+/**
+ * Retrieves the number of frames in a tag, or of the whole sheet if the tag
+ * is -1.
+ */
+Uint32 sprite_sheet_tag_length(const SpriteSheet *sheet, int tag);
+
+/**
+ * Retrieves a frame by its index relative to a tag, or to the whole sheet if
+ * the tag is -1.
+ */
+const SpriteFrame *sprite_sheet_frame(const SpriteSheet *sheet, int tag,
+                                      Uint32 idx);
+
+/**
+ * Steps through a run of frames by the time accumulated on the current frame.
+ * This moves past as many frames as the time covers, wrapping around, and
+ * keeps the leftover time in `accum`. `loop_secs` is the duration of the
+ * whole run, used to skip full loops at once.
+ *
+ * Returns true if the frame changed.
+ */
+bool sprite_frames_step(const float *secs, Uint32 length, float loop_secs,
+                        Uint32 *frame, float *accum);
+
+/**
+ * Sets the animator's tag, and resets it back to the first frame.
+ */
+void sprite_animator_set_tag(SpriteAnimator *anim, int tag);
+
+/**
+ * Resets an animator back to the default state.
+ */
+void sprite_animator_reset(SpriteAnimator *anim);
+
+/**
+ * Advances an animator by a deltatime amount, with the frames of a sheet.
+ * This does nothing if the animator is not playing. A long deltatime can
+ * advance several frames at once.
+ *
+ * Returns true if the animator moved to another frame.
+ */
+bool sprite_animator_advance(SpriteAnimator *anim, const SpriteSheet *sheet,
+                             double dt);
+
+/**
+ * Creates a sprite of a sprite asset. The sheet is acquired from the asset
+ * registry, so it's only loaded if no one holds it yet, and released when the
+ * sprite is destroyed.
  */
 Sprite *sprite_init(const char *sprite);
 
+/**
+ * Creates a sprite that shares an already loaded sheet.
+ */
+Sprite *sprite_init_shared(SpriteSheet *sheet);
+
 /**
  * Sets the sprite animation's currently selected tag.
  */
@@ -73,11 +203,17 @@ void sprite_reset_animation(Sprite *spr);
  * Advances a sprite's animation status by a deltatime amount.
  * This does nothing if the sprite is not playing.
  *
- * Returns true if the sprite was advanced a step.
+ * Returns true if the sprite moved to another frame.
  */
 bool sprite_advance_animation(Sprite *spr, double dt);
 
 /**
- * Destroys a sprite.
+ * Retrieves the frame the sprite is currently on.
+ */
+const SpriteFrame *sprite_current_frame(const Sprite *spr);
+
+/**
+ * Destroys a sprite, and releases its sheet, and its asset if it was made with
+ * `sprite_init`.
  */
 void sprite_destroy(Sprite *spr);
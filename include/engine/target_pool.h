@@ -0,0 +1,66 @@
+// engine/target_pool.h
+//
+// A pool of render target textures. Scenes and transitions borrow offscreen
+// targets from here instead of creating and destroying their own, so textures
+// only get allocated when the logical resolution actually changes.
+
+#pragma once
+
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_render.h"
+#include "misc/list.h"
+
+/**
+ * Represents a texture owned by the pool.
+ */
+typedef struct
+{
+    SDL_Texture *texture;
+    int w, h;
+    SDL_PixelFormat format;
+    bool in_use; // Whether someone borrowed this texture.
+} PooledTarget;
+
+/**
+ * Represents the pool of render targets.
+ */
+typedef struct
+{
+    SDL_Renderer *renderer;
+    List *targets; // The pooled targets, as PooledTarget *.
+    int w, h;      // The size most targets are expected to be.
+} RenderTargetPool;
+
+/**
+ * Initializes an empty pool that creates targets with the provided renderer.
+ */
+RenderTargetPool *target_pool_init(SDL_Renderer *renderer);
+
+/**
+ * Borrows a render target of the provided size and format. This reuses a free
+ * target if one matches, and only creates a new texture otherwise.
+ *
+ * The texture is handed out with blending on, and no alpha or color mod.
+ * Returns NULL if a new texture couldn't be created.
+ */
+SDL_Texture *target_pool_acquire(RenderTargetPool *pool, int w, int h,
+                                 SDL_PixelFormat format);
+
+/**
+ * Gives a borrowed render target back to the pool. Targets that are not of
+ * the pool's current size are destroyed instead. Passing NULL does nothing.
+ */
+void target_pool_release(RenderTargetPool *pool, SDL_Texture *texture);
+
+/**
+ * Sets the size most targets are expected to be, usually the logical
+ * resolution. Free targets of any other size are destroyed.
+ *
+ * Returns false if the size didn't change.
+ */
+bool target_pool_resize(RenderTargetPool *pool, int w, int h);
+
+/**
+ * Destroys the pool and every texture in it, borrowed or not.
+ */
+void target_pool_destroy(RenderTargetPool *pool);
@@ -24,6 +24,8 @@ typedef enum
 
     // The debug font face that can also display all Unicode characters.
     FONT_FACE_UNIFONT,
+
+    NUM_FONT_FACES,
 } FontFace;
 
 /**
@@ -50,15 +52,68 @@ typedef struct
 } FontRenderingOptions;
 
 /**
- * Initializes the engine needed to create fonts.
+ * Represents a text that is kept across frames. The text is rasterized into
+ * its own texture, and only rasterized again when its string, font or color
+ * changes, so drawing an unchanged label is a single textured quad.
+ */
+typedef struct TextLabel
+{
+    Font font;
+    char *text;
+    SDL_Color color;
+
+    TTF_Text *ttf_text;   // The laid out text, from the font engine.
+    SDL_Texture *texture; // The rasterized text, premultiplied.
+    int w, h;             // The size of the rasterized text.
+    bool dirty;           // Whether the texture is out of date.
+} TextLabel;
+
+/**
+ * Initializes the engine needed to create fonts. This reads every font file
+ * into memory, and opens the commonly used fonts ahead of time.
  */
 bool font_engine_init(AppState *app);
 
 /**
- * Renders a text.
+ * Renders a text. Glyphs are cached in a per-font atlas the first time they're
+ * drawn, and the whole string is submitted as a single batch of quads.
  */
 void font_engine_render_text(FontRenderingOptions opts);
 
+/**
+ * Creates a label for a text. Returns NULL if the text couldn't be laid out.
+ * The other label functions do nothing when given a NULL label.
+ *
+ * The label's font is kept open while the label lives.
+ */
+TextLabel *text_label_init(Font font, const char *text, SDL_Color color);
+
+/**
+ * Changes the label's string. Nothing happens if the string is the same.
+ */
+void text_label_set_text(TextLabel *label, const char *text);
+
+/**
+ * Changes the label's font. Nothing happens if the font is the same.
+ */
+void text_label_set_font(TextLabel *label, Font font);
+
+/**
+ * Changes the label's color. Nothing happens if the color is the same.
+ */
+void text_label_set_color(TextLabel *label, SDL_Color color);
+
+/**
+ * Draws the label at a position, rasterizing it first if it changed.
+ */
+void text_label_render(TextLabel *label, double x, double y,
+                       RenderingOriginType origin);
+
+/**
+ * Destroys the label and its texture.
+ */
+void text_label_destroy(TextLabel *label);
+
 /**
  * Destroys the initialized font engines.
  */
@@ -14,7 +14,8 @@
 void scene_setup(void);
 
 /**
- * Initializes an empty scene with the render draw color.
+ * Initializes an empty scene with the render draw color. A rectangle covering
+ * the whole screen keeps covering it when the window is resized.
  */
 Scene *scene_empty_init(SDL_Color color, SDL_FRect rect);
 
@@ -22,3 +23,9 @@ Scene *scene_empty_init(SDL_Color color, SDL_FRect rect);
  * Initializes the FPS scene.
  */
 Scene *scene_fps_init(SDL_Color color);
+
+/**
+ * Initializes the loading scene, a progress bar the scene manager shows while
+ * scenes take long to load.
+ */
+Scene *scene_loading_init(SDL_Color color);
@@ -0,0 +1,126 @@
+// misc/array.h
+//
+// Typed dynamic arrays, that store their values inline instead of pointers to
+// them. An array is declared with ARRAY(type), or SMALL_ARRAY(type, n) to keep
+// its first n values inside of itself, and only allocate once it outgrows
+// them. Both are used with the same array_* macros.
+
+#pragma once
+
+#include "SDL3/SDL_stdinc.h"
+
+// The fields every array starts with. `fixed` is whether `items` is the inline
+// buffer of a small array, which is not freed.
+#define ARRAY_FIELDS(T)                                                        \
+    T *items;                                                                  \
+    Uint32 length;                                                             \
+    Uint32 capacity;                                                           \
+    bool fixed
+
+/**
+ * Declares an array of values of type T.
+ */
+#define ARRAY(T)                                                               \
+    struct                                                                     \
+    {                                                                          \
+        ARRAY_FIELDS(T);                                                       \
+    }
+
+/**
+ * Declares an array of values of type T, with room for n of them inline. A
+ * small array points into itself, so it must not be copied or moved while
+ * it's using that room.
+ */
+#define SMALL_ARRAY(T, n)                                                      \
+    struct                                                                     \
+    {                                                                          \
+        ARRAY_FIELDS(T);                                                       \
+        T buffer[n];                                                           \
+    }
+
+/**
+ * Initializes an empty array. Nothing is allocated until the first value.
+ */
+#define array_init(a)                                                          \
+    ((a)->items = NULL, (a)->length = 0, (a)->capacity = 0, (a)->fixed = false)
+
+/**
+ * Initializes an empty small array, using its inline room.
+ */
+#define small_array_init(a)                                                    \
+    ((a)->items = (a)->buffer, (a)->length = 0,                                \
+     (a)->capacity = (Uint32)SDL_arraysize((a)->buffer), (a)->fixed = true)
+
+/**
+ * Makes sure the array can hold n values. Returns false if it couldn't grow.
+ */
+#define array_reserve(a, n)                                                    \
+    ((n) <= (a)->capacity ||                                                   \
+     ((a)->items = array_grow((a)->items, (a)->length, (n),                    \
+                              sizeof(*(a)->items), &(a)->capacity,             \
+                              &(a)->fixed),                                    \
+      (n) <= (a)->capacity))
+
+/**
+ * Adds a value at the end. Returns false if the array couldn't grow.
+ */
+#define array_push(a, value)                                                   \
+    (array_reserve((a), (a)->length + 1)                                       \
+         ? ((a)->items[(a)->length++] = (value), true)                         \
+         : false)
+
+/**
+ * Adds a value at an index, moving the ones after it. Returns false if the
+ * index is past the end, or if the array couldn't grow.
+ */
+#define array_insert(a, idx, value)                                            \
+    (array_insert_check((a)->length, (idx)) &&                                 \
+             array_reserve((a), (a)->length + 1)                               \
+         ? (SDL_memmove(&(a)->items[(idx) + 1], &(a)->items[(idx)],            \
+                        ((a)->length - (idx)) * sizeof(*(a)->items)),          \
+            (a)->items[(idx)] = (value), (a)->length++, true)                  \
+         : false)
+
+/**
+ * Removes the value at an index, keeping the others in order.
+ */
+#define array_remove_at(a, idx)                                                \
+    ((idx) < (a)->length                                                       \
+         ? (SDL_memmove(&(a)->items[(idx)], &(a)->items[(idx) + 1],            \
+                        ((a)->length - (idx) - 1) * sizeof(*(a)->items)),      \
+            (a)->length--, true)                                               \
+         : false)
+
+/**
+ * Removes every value. The memory is kept for the next ones.
+ */
+#define array_clear(a) ((a)->length = 0)
+
+/**
+ * Frees the array's memory. A small array must be initialized again before
+ * it's reused.
+ */
+#define array_free(a)                                                          \
+    (array_release((a)->items, (a)->fixed), array_init(a))
+
+/**
+ * Grows the memory of an array to hold at least `needed` values, copying the
+ * inline room of a small array out. Use `array_reserve` instead.
+ *
+ * Returns the new items, or the same ones if they couldn't grow.
+ */
+void *array_grow(void *items, Uint32 length, Uint32 needed, size_t size,
+                 Uint32 *capacity, bool *fixed);
+
+/**
+ * Checks if a value can be inserted at an index, that is up to the end. This
+ * is a function so that inserting at a constant 0 doesn't compare an unsigned
+ * value to 0. Use `array_insert` instead.
+ */
+bool array_insert_check(Uint32 length, Uint32 idx);
+
+/**
+ * Frees the items of an array, unless they are inline. Use `array_free`
+ * instead.
+ */
+void array_release(void *items, bool fixed);
@@ -1,29 +1,35 @@
 // misc/hashmap.h
 //
-// Represents a simple string as a key hash map.
+// Represents a hash map from unsigned ints to pointers. Entries are stored
+// inline in a single array with Robin Hood probing, so a lookup usually reads
+// one cache line, and nothing is allocated per entry.
 
 #pragma once
 
-#define HASH_MAP_MAX_BUCKETS 256
+// How many entries a map holds when it first allocates, and how full it gets,
+// in quarters, before it grows.
+#define HASH_MAP_MIN_CAPACITY 8
+#define HASH_MAP_MAX_LOAD 3
 
 #include "SDL3/SDL_stdinc.h"
 
 /**
- * Represents a node inside the hash map.
+ * Represents an entry inside the hash map.
  */
-typedef struct HashMapNode
+typedef struct
 {
     Uint32 key;
+    Uint32 dist; // How far it is from its ideal slot, plus 1. 0 if free.
     void *value;
-    struct HashMapNode *next;
-} HashMapNode;
+} HashMapEntry;
 
 /**
- * Represents a simple hash map using unsigned ints as values.
+ * Represents a simple hash map using unsigned ints as keys.
  */
 typedef struct
 {
-    HashMapNode *nodes[HASH_MAP_MAX_BUCKETS];
+    HashMapEntry *entries; // NULL until the first item is put.
+    Uint32 capacity;       // Always a power of 2.
     Uint32 size;
 } HashMap;
 
@@ -10,9 +10,9 @@ mkdir -p artifacts
 echo "Copying libraries to frameworks"
 cp -R -v build/lib/. build/bin/CCSakura.app/Contents/Frameworks
 
-echo "Copying assets to resources"
-mkdir -p build/bin/CCSakura.app/Contents/Resources/assets
-cp -R -v assets/. build/bin/CCSakura.app/Contents/Resources/assets
+echo "Packing assets into resources"
+mkdir -p build/bin/CCSakura.app/Contents/Resources
+python3 tools/pack_assets.py assets build/bin/CCSakura.app/Contents/Resources/assets.pack || exit 1
 
 echo "Moving to artifacts for distribution"
 mv -v build/bin/CCSakura.app artifacts/CCSakura.app
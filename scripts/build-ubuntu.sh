@@ -3,13 +3,13 @@
 cmake -S . -B build
 cmake --build build
 
-mkdir -p CCSakura-linux/{bin,lib,assets}
+mkdir -p CCSakura-linux/{bin,lib}
 
 echo "Copying binary"
 cp -v build/bin/CCSakura CCSakura-linux/bin/
 
-echo "Copying assets"
-cp -v -r assets/* CCSakura-linux/assets/
+echo "Packing assets"
+python3 tools/pack_assets.py assets CCSakura-linux/bin/assets.pack || exit 1
 
 echo "Copying libraries"
 ldd build/bin/CCSakura | grep "=> /" | awk '{print $3}' | xargs -I '{}' cp -v '{}' CCSakura-linux/lib/
@@ -25,9 +25,17 @@ Get-ChildItem -Recurse ".\build\bin\"
 Write-Host "Viewing the directories of build\lib\"
 Get-ChildItem -Recurse ".\build\lib\"
 
-Write-Host "Copying assets"
+Write-Host "Copying binaries"
 Copy-Item -Path ".\build\bin\*" -Destination ".\CCSakura-Win\" -Recurse -Force -Verbose
-Copy-Item -Path ".\assets" -Destination ".\CCSakura-Win\assets" -Recurse -Force -Verbose
+
+Write-Host "Packing assets"
+python tools\pack_assets.py assets ".\CCSakura-Win\assets.pack"
+
+if($LASTEXITCODE -ne 0)
+{
+    Write-Host "Packing assets failed. Aborting..."
+    exit(1)
+}
 
 Write-Host "Copying libraries"
 Copy-Item -Path ".\build\lib\*" -Destination ".\CCSakura-Win\" -Recurse -Force -Verbose
@@ -9,7 +9,9 @@
 #include "SDL3/SDL_stdinc.h"
 #include "SDL3/SDL_timer.h"
 #include "SDL3/SDL_video.h"
+#include "engine/pacing.h"
 #include "engine/scene.h"
+#include "engine/target_pool.h"
 #include "misc/list.h"
 #include "misc/stack.h"
 #include <string.h>
@@ -24,7 +26,7 @@ AppState *app_init(void)
     state->frame_data.frame_count = 0;
     state->frame_data.frame_accum = 0;
     state->frame_data.frame_time = 0;
-    state->frame_data.last_frame_tick = SDL_GetTicks();
+    state->frame_data.last_frame_tick = SDL_GetTicksNS();
     state->frame_data.fps = 0;
 
     // Memset keyboard state to all 0, since it's only bools.
@@ -43,15 +45,32 @@ AppState *app_init(void)
     }
 
     SDL_SetRenderDrawBlendMode(state->window.renderer, SDL_BLENDMODE_BLEND);
-    SDL_GetRenderOutputSize(state->window.renderer, &state->window.w,
-                            &state->window.h);
-
-    // Create the texture to render into.
-    state->scene_mgr.target = SDL_CreateTexture(
-        state->window.renderer, SDL_PIXELFORMAT_RGBA8888,
-        SDL_TEXTUREACCESS_TARGET, state->window.w, state->window.h);
-    if (!state->scene_mgr.target)
+
+    // Setup frame pacing.
+    frame_pacer_init(&state->pacer, APPLICATION_TARGET_FPS);
+    frame_pacer_set_vsync(&state->pacer, state->window.renderer,
+                          APPLICATION_VSYNC);
+    app_update_window_size(state);
+
+    // Create scene manager.
+    state->scene_mgr.scenes = stack_init(APPLICATION_MAX_SCENE_COUNT);
+    small_array_init(&state->scene_mgr.transitions);
+    state->scene_mgr.preparing = list_init();
+    state->scene_mgr.loading = NULL;
+
+    // Create the textures to render into.
+    state->scene_mgr.canvas = NULL;
+    state->scene_mgr.target = NULL;
+    state->scene_mgr.snapshot = NULL;
+    state->scene_mgr.snapshot_focus = NULL;
+    state->scene_mgr.targets = target_pool_init(state->window.renderer);
+    if (!scene_mgr_resize(&state->scene_mgr, state->window.logical_w,
+                          state->window.logical_h))
     {
+        target_pool_destroy(state->scene_mgr.targets);
+        stack_destroy(state->scene_mgr.scenes);
+        array_free(&state->scene_mgr.transitions);
+        list_destroy(state->scene_mgr.preparing);
         SDL_LogError(SDL_LOG_CATEGORY_RENDER,
                      "Can't create scene rendering target.");
         SDL_DestroyWindow(state->window.window);
@@ -59,11 +78,6 @@ AppState *app_init(void)
         SDL_free(state);
         return NULL;
     }
-    SDL_SetTextureBlendMode(state->scene_mgr.target, SDL_BLENDMODE_BLEND);
-
-    // Create scene manager.
-    state->scene_mgr.scenes = stack_init(APPLICATION_MAX_SCENE_COUNT);
-    state->scene_mgr.transitions = list_init();
 
     appstate = state;
     return state;
@@ -75,25 +89,50 @@ AppState *app_get(void)
     return appstate;
 }
 
-void app_destroy(AppState *state)
+void app_update_window_size(AppState *app)
+{
+    SDL_GetRenderOutputSize(app->window.renderer, &app->window.w,
+                            &app->window.h);
+
+    // Round up, so the upscaled canvas always covers the whole window.
+    app->window.logical_w =
+        (app->window.w + APPLICATION_SCALE - 1) / APPLICATION_SCALE;
+    app->window.logical_h =
+        (app->window.h + APPLICATION_SCALE - 1) / APPLICATION_SCALE;
+}
+
+void app_destroy_scenes(AppState *state)
 {
     if (!state)
         return;
 
+    // Scenes still loading were never pushed, and take the loading scene off
+    // the stack.
+    scene_mgr_cancel_preparations(&state->scene_mgr);
+
     for (int i = 0; i < state->scene_mgr.scenes->length; i++)
     {
         scene_destroy(state->scene_mgr.scenes->items[i]);
     }
+    stack_clear(state->scene_mgr.scenes);
+
+    scene_destroy(state->scene_mgr.loading);
+    state->scene_mgr.loading = NULL;
+}
+
+void app_destroy(AppState *state)
+{
+    if (!state)
+        return;
+
+    app_destroy_scenes(state);
     stack_destroy(state->scene_mgr.scenes);
 
-    for (int i = 0; i < (int)state->scene_mgr.transitions->length; i++)
-    {
-        SceneTransition *trans = state->scene_mgr.transitions->items[i];
-        SDL_DestroyTexture(trans->from_txt);
-        SDL_DestroyTexture(trans->to_txt);
-        SDL_free(trans);
-    }
-    list_destroy(state->scene_mgr.transitions);
+    array_free(&state->scene_mgr.transitions);
+    list_destroy(state->scene_mgr.preparing);
+
+    // This also destroys the textures the transitions were using.
+    target_pool_destroy(state->scene_mgr.targets);
 
     SDL_DestroyWindow(state->window.window);
     SDL_DestroyRenderer(state->window.renderer);
@@ -101,13 +140,13 @@ void app_destroy(AppState *state)
     appstate = NULL;
 }
 
-char *app_res_path(const char *subpath)
+bool app_res_path(const char *subpath, char *buf, size_t size)
 {
-    char *path = SDL_calloc(1024, sizeof(char));
-
-    SDL_strlcat(path, SDL_GetBasePath(), 1024);
-    SDL_strlcat(path, "/", 1024);
-    SDL_strlcat(path, subpath, 1024);
+    // The base path already ends with a separator.
+    const char *base = SDL_GetBasePath();
+    if (!base)
+        base = "";
 
-    return path;
+    size_t len = (size_t)SDL_snprintf(buf, size, "%s%s", base, subpath);
+    return len < size;
 }
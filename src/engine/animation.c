@@ -0,0 +1,238 @@
+#include "engine/animation.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_stdinc.h"
+#include "engine/sprite.h"
+
+AnimationSystem *animation_system_init(void)
+{
+    return SDL_calloc(1, sizeof(AnimationSystem));
+}
+
+/**
+ * Makes sure the packed arrays can hold one more animation.
+ */
+bool animation_system_reserve(AnimationSystem *sys)
+{
+    if (sys->num_anims < sys->cap_anims)
+        return true;
+
+    Uint32 cap = sys->cap_anims == 0 ? 16 : sys->cap_anims * 2;
+
+    Animation *anims = SDL_realloc(sys->anims, sizeof(Animation) * cap);
+    if (!anims)
+        return false;
+    sys->anims = anims;
+
+    SpriteSheet **sheets =
+        SDL_realloc(sys->sheets, sizeof(SpriteSheet *) * cap);
+    if (!sheets)
+        return false;
+    sys->sheets = sheets;
+
+    AnimationId *ids = SDL_realloc(sys->ids, sizeof(AnimationId) * cap);
+    if (!ids)
+        return false;
+    sys->ids = ids;
+
+    // There are never more handles than animations, so these grow along.
+    Uint32 *slots = SDL_realloc(sys->slots, sizeof(Uint32) * cap);
+    if (!slots)
+        return false;
+    sys->slots = slots;
+
+    AnimationId *free_ids =
+        SDL_realloc(sys->free_ids, sizeof(AnimationId) * cap);
+    if (!free_ids)
+        return false;
+    sys->free_ids = free_ids;
+
+    sys->cap_anims = cap;
+    return true;
+}
+
+/**
+ * Points an animation at a tag of its sheet, from the first frame.
+ */
+void animation_bind_tag(Animation *anim, const SpriteSheet *sheet, int tag)
+{
+    anim->first_frame = tag >= 0 ? sheet->tags[tag].from : 0;
+    anim->num_frames = sprite_sheet_tag_length(sheet, tag);
+    anim->loop_secs = tag >= 0 ? sheet->tags[tag].secs : sheet->secs;
+    anim->secs = sheet->frame_secs ? sheet->frame_secs + anim->first_frame
+                                   : NULL;
+    anim->frame_idx = 0;
+    anim->frame_accum = 0;
+}
+
+/**
+ * Finds the packed index of an animation, or -1 if there is no such handle.
+ */
+Sint64 animation_system_slot(AnimationSystem *sys, AnimationId id)
+{
+    if (id == 0 || id > sys->num_slots)
+        return -1;
+
+    Uint32 slot = sys->slots[id - 1];
+    if (slot >= sys->num_anims || sys->ids[slot] != id)
+        return -1;
+
+    return slot;
+}
+
+AnimationId animation_system_add(AnimationSystem *sys, SpriteSheet *sheet,
+                                 int tag)
+{
+    if (!sheet || tag >= (int)sheet->num_tags)
+        return 0;
+
+    if (!animation_system_reserve(sys))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to grow the animation system");
+        return 0;
+    }
+
+    AnimationId id;
+    if (sys->num_free_ids > 0)
+        id = sys->free_ids[--sys->num_free_ids];
+    else
+        id = ++sys->num_slots;
+
+    Uint32 slot = sys->num_anims++;
+    sys->slots[id - 1] = slot;
+    sys->ids[slot] = id;
+    sys->sheets[slot] = sprite_sheet_ref(sheet);
+
+    Animation *anim = &sys->anims[slot];
+    anim->playing = false;
+    animation_bind_tag(anim, sheet, tag);
+    return id;
+}
+
+void animation_system_remove(AnimationSystem *sys, AnimationId id)
+{
+    Sint64 found = animation_system_slot(sys, id);
+    if (found < 0)
+        return;
+
+    Uint32 slot = (Uint32)found;
+    sprite_sheet_release(sys->sheets[slot]);
+
+    // Move the last animation into the hole, so the arrays stay packed.
+    Uint32 last = --sys->num_anims;
+    if (slot != last)
+    {
+        sys->anims[slot] = sys->anims[last];
+        sys->sheets[slot] = sys->sheets[last];
+        sys->ids[slot] = sys->ids[last];
+        sys->slots[sys->ids[slot] - 1] = slot;
+    }
+
+    sys->free_ids[sys->num_free_ids++] = id;
+}
+
+bool animation_system_set_tag(AnimationSystem *sys, AnimationId id, int tag)
+{
+    Sint64 slot = animation_system_slot(sys, id);
+    if (slot < 0)
+        return false;
+
+    SpriteSheet *sheet = sys->sheets[slot];
+    if (tag >= (int)sheet->num_tags)
+        return false;
+
+    animation_bind_tag(&sys->anims[slot], sheet, tag);
+    return true;
+}
+
+void animation_system_set_playing(AnimationSystem *sys, AnimationId id,
+                                  bool playing)
+{
+    Sint64 slot = animation_system_slot(sys, id);
+    if (slot >= 0)
+        sys->anims[slot].playing = playing;
+}
+
+const SpriteFrame *animation_system_frame(AnimationSystem *sys,
+                                          AnimationId id)
+{
+    Sint64 slot = animation_system_slot(sys, id);
+    if (slot < 0)
+        return NULL;
+
+    Animation *anim = &sys->anims[slot];
+    if (anim->num_frames == 0)
+        return NULL;
+
+    return &sys->sheets[slot]->frames[anim->first_frame + anim->frame_idx];
+}
+
+/**
+ * Records that an animation moved to another frame.
+ */
+void animation_system_push_event(AnimationSystem *sys, AnimationId id,
+                                 Uint32 frame_idx)
+{
+    if (sys->num_events == sys->cap_events)
+    {
+        Uint32 cap = sys->cap_events == 0 ? 16 : sys->cap_events * 2;
+        AnimationEvent *events =
+            SDL_realloc(sys->events, sizeof(AnimationEvent) * cap);
+        if (!events)
+            return;
+        sys->events = events;
+        sys->cap_events = cap;
+    }
+
+    sys->events[sys->num_events++] = (AnimationEvent){
+        .id = id,
+        .frame_idx = frame_idx,
+    };
+}
+
+void animation_system_tick(AnimationSystem *sys, double dt)
+{
+    sys->num_events = 0;
+
+    float step = (float)dt;
+    for (Uint32 i = 0; i < sys->num_anims; i++)
+    {
+        Animation *anim = &sys->anims[i];
+        if (!anim->playing || anim->num_frames == 0)
+            continue;
+
+        anim->frame_accum += step;
+
+        // Most ticks don't reach the end of the frame.
+        if (anim->frame_accum < anim->secs[anim->frame_idx])
+            continue;
+
+        if (sprite_frames_step(anim->secs, anim->num_frames, anim->loop_secs,
+                               &anim->frame_idx, &anim->frame_accum))
+            animation_system_push_event(sys, sys->ids[i], anim->frame_idx);
+    }
+}
+
+const AnimationEvent *animation_system_events(AnimationSystem *sys,
+                                              Uint32 *count)
+{
+    *count = sys->num_events;
+    return sys->events;
+}
+
+void animation_system_destroy(AnimationSystem *sys)
+{
+    if (!sys)
+        return;
+
+    for (Uint32 i = 0; i < sys->num_anims; i++)
+        sprite_sheet_release(sys->sheets[i]);
+
+    SDL_free(sys->anims);
+    SDL_free(sys->sheets);
+    SDL_free(sys->ids);
+    SDL_free(sys->slots);
+    SDL_free(sys->free_ids);
+    SDL_free(sys->events);
+    SDL_free(sys);
+}
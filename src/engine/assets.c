@@ -0,0 +1,252 @@
+#include "engine/assets.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_stdinc.h"
+#include "engine/map.h"
+#include "engine/sprite.h"
+#include "misc/hashmap.h"
+#include "misc/list.h"
+
+/**
+ * Represents a loaded asset. Assets whose keys collide are chained.
+ */
+typedef struct AssetEntry
+{
+    AssetType type;
+    char *name;
+    void *data;
+    Uint32 refs;
+    struct AssetEntry *next;
+} AssetEntry;
+
+// The loaded assets, by the hash of their type and name.
+static HashMap *assets = NULL;
+
+// Every loaded asset, to unload what's left on shutdown.
+static List *loaded_assets = NULL;
+
+/**
+ * Hashes an asset's type and name into a key, with FNV-1a.
+ */
+Uint32 asset_key(AssetType type, const char *name)
+{
+    Uint32 hash = 2166136261u;
+    hash = (hash ^ (Uint32)type) * 16777619u;
+    for (const char *c = name; *c; c++)
+        hash = (hash ^ (Uint8)*c) * 16777619u;
+    return hash;
+}
+
+/**
+ * Loads an asset from the disk.
+ */
+void *asset_load(AssetType type, const char *name)
+{
+    switch (type)
+    {
+    case ASSET_TYPE_SPRITE:
+        return sprite_sheet_init(name);
+    case ASSET_TYPE_MAP:
+        return map_init(name);
+    default:
+        return NULL;
+    }
+}
+
+void assets_get_path(AssetType type, const char *name, char *buf, size_t size)
+{
+    switch (type)
+    {
+    case ASSET_TYPE_SPRITE:
+        SDL_snprintf(buf, size, "assets/spr/%s.sprite", name);
+        break;
+    case ASSET_TYPE_MAP:
+        SDL_snprintf(buf, size, "assets/map/%s.map", name);
+        break;
+    }
+}
+
+void assets_free_data(AssetType type, void *data)
+{
+    switch (type)
+    {
+    case ASSET_TYPE_SPRITE:
+        // Sprites made from the sheet keep it alive until they're destroyed.
+        sprite_sheet_release(data);
+        break;
+    case ASSET_TYPE_MAP:
+        map_destroy(data);
+        break;
+    }
+}
+
+bool assets_init(void)
+{
+    assets = hash_map_init();
+    loaded_assets = list_init();
+    return assets != NULL && loaded_assets != NULL;
+}
+
+/**
+ * Finds a loaded asset. Returns NULL if no one holds it.
+ */
+AssetEntry *asset_find(AssetType type, const char *name)
+{
+    for (AssetEntry *cur = hash_map_get(assets, asset_key(type, name)); cur;
+         cur = cur->next)
+    {
+        if (cur->type == type && SDL_strcmp(cur->name, name) == 0)
+            return cur;
+    }
+
+    return NULL;
+}
+
+/**
+ * Adds a loaded asset to the registry, with a single user.
+ */
+void asset_insert(AssetType type, const char *name, void *data)
+{
+    Uint32 key = asset_key(type, name);
+
+    AssetEntry *entry = SDL_malloc(sizeof(AssetEntry));
+    entry->type = type;
+    entry->name = SDL_strdup(name);
+    entry->data = data;
+    entry->refs = 1;
+    entry->next = hash_map_get(assets, key);
+    hash_map_put(assets, key, entry);
+    list_add(loaded_assets, entry);
+}
+
+void *assets_acquire(AssetType type, const char *name)
+{
+    AssetEntry *entry = asset_find(type, name);
+    if (entry)
+    {
+        entry->refs++;
+        return entry->data;
+    }
+
+    void *data = asset_load(type, name);
+    if (!data)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Unable to load asset %s",
+                     name);
+        return NULL;
+    }
+
+    asset_insert(type, name, data);
+    return data;
+}
+
+bool assets_hold(AssetType type, const char *name)
+{
+    AssetEntry *entry = asset_find(type, name);
+    if (!entry)
+        return false;
+
+    entry->refs++;
+    return true;
+}
+
+void *assets_adopt(AssetType type, const char *name, void *data)
+{
+    // Someone else loaded it in the meantime, keep theirs.
+    AssetEntry *entry = asset_find(type, name);
+    if (entry)
+    {
+        assets_free_data(type, data);
+        entry->refs++;
+        return entry->data;
+    }
+
+    asset_insert(type, name, data);
+    return data;
+}
+
+SpriteSheet *assets_acquire_sprite(const char *name)
+{
+    return assets_acquire(ASSET_TYPE_SPRITE, name);
+}
+
+Map *assets_acquire_map(const char *name)
+{
+    return assets_acquire(ASSET_TYPE_MAP, name);
+}
+
+void assets_release(AssetType type, const char *name)
+{
+    Uint32 key = asset_key(type, name);
+    AssetEntry *head = hash_map_get(assets, key);
+
+    AssetEntry *prev = NULL;
+    for (AssetEntry *cur = head; cur; prev = cur, cur = cur->next)
+    {
+        if (cur->type != type || SDL_strcmp(cur->name, name) != 0)
+            continue;
+
+        if (--cur->refs > 0)
+            return;
+
+        // Last user is gone, unlink and unload it.
+        if (prev)
+            prev->next = cur->next;
+        else if (cur->next)
+            hash_map_put(assets, key, cur->next);
+        else
+            hash_map_remove(assets, key);
+        list_remove(loaded_assets, cur);
+
+        assets_free_data(cur->type, cur->data);
+        SDL_free(cur->name);
+        SDL_free(cur);
+        return;
+    }
+
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                "Releasing asset %s that is not loaded", name);
+}
+
+bool assets_preload(const AssetRef *refs, Uint32 count)
+{
+    for (Uint32 i = 0; i < count; i++)
+    {
+        if (!assets_acquire(refs[i].type, refs[i].name))
+        {
+            // Let go of the ones we did get.
+            assets_release_list(refs, i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void assets_release_list(const AssetRef *refs, Uint32 count)
+{
+    for (Uint32 i = 0; i < count; i++)
+        assets_release(refs[i].type, refs[i].name);
+}
+
+void assets_destroy(void)
+{
+    if (!assets)
+        return;
+
+    // Every asset should have been released by now. Whatever is left gets
+    // unloaded regardless.
+    for (Uint32 i = 0; i < loaded_assets->length; i++)
+    {
+        AssetEntry *entry = loaded_assets->items[i];
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Asset %s was never released", entry->name);
+        assets_free_data(entry->type, entry->data);
+        SDL_free(entry->name);
+        SDL_free(entry);
+    }
+
+    list_destroy(loaded_assets);
+    hash_map_destroy(assets);
+    loaded_assets = NULL;
+    assets = NULL;
+}
@@ -7,6 +7,10 @@
 #include "SDL3/SDL_stdinc.h"
 #include "SDL3/SDL_timer.h"
 #include "app.h"
+#include "engine/assets.h"
+#include "engine/loader.h"
+#include "engine/pack.h"
+#include "engine/pacing.h"
 #include "engine/scene.h"
 #include "engine/text.h"
 #include <stdint.h>
@@ -16,8 +20,9 @@
 void engine_iterate(AppState *app)
 {
     // Calculate delta time
-    Uint64 cur_frame = SDL_GetTicks();
-    double dt = (cur_frame - app->frame_data.last_frame_tick) / 1000.0;
+    Uint64 cur_frame = SDL_GetTicksNS();
+    Uint64 elapsed = cur_frame - app->frame_data.last_frame_tick;
+    double dt = (double)elapsed / SDL_NS_PER_SECOND;
     app->frame_data.last_frame_tick = cur_frame;
 
     if (dt > 0.1)
@@ -34,6 +39,9 @@ void engine_iterate(AppState *app)
         scene_mgr_phys_tick(&app->scene_mgr);
     }
 
+    // Move background loads along, before the scenes look at them.
+    loader_update(LOADER_FRAME_BUDGET_NS);
+
     // Tick every frame.
     scene_mgr_tick(&app->scene_mgr, dt);
 
@@ -54,21 +62,13 @@ void engine_handle_event(AppState *app, SDL_Event *event)
     switch (event->type)
     {
     case SDL_EVENT_WINDOW_RESIZED:
-        SDL_GetRenderOutputSize(app->window.renderer, &app->window.w,
-                                &app->window.h);
-        SDL_DestroyTexture(app->scene_mgr.target);
-        app->scene_mgr.target = SDL_CreateTexture(
-            app->window.renderer, SDL_PIXELFORMAT_RGBA8888,
-            SDL_TEXTUREACCESS_TARGET, app->window.w, app->window.h);
-
-        // Reapply render target.
-        if (SDL_GetRenderTarget(app->window.renderer) != NULL)
-            SDL_SetRenderTarget(app->window.renderer, app->scene_mgr.target);
-        else
-            SDL_SetRenderTarget(app->window.renderer, NULL);
-        SDL_SetTextureBlendMode(app->scene_mgr.target, SDL_BLENDMODE_BLEND);
-
-        SDL_LogInfo(SDL_LOG_CATEGORY_VIDEO, "Resized rendering target.");
+        app_update_window_size(app);
+        scene_mgr_resize(&app->scene_mgr, app->window.logical_w,
+                         app->window.logical_h);
+        break;
+    case SDL_EVENT_WINDOW_EXPOSED:
+        // The window's contents were lost, we have to draw them again.
+        scene_mgr_mark_dirty(&app->scene_mgr);
         break;
     case SDL_EVENT_KEY_DOWN:
         app->input.keyboard[event->key.scancode] = true;
@@ -81,21 +81,58 @@ void engine_handle_event(AppState *app, SDL_Event *event)
 
 void engine_render(AppState *app)
 {
-    // Clear the renderer.
-    SDL_SetRenderDrawColor(app->window.renderer, 255, 255, 255, 255);
-    SDL_RenderClear(app->window.renderer);
+    // Nothing changed since the last frame, the window still shows it.
+    if (!scene_mgr_needs_redraw(&app->scene_mgr))
+        return;
+
+    SDL_Renderer *renderer = app->window.renderer;
 
-    // Render the scenes I guess
+    // Render the scenes I guess. Every scene is drawn into the canvas at the
+    // logical resolution.
     scene_mgr_draw(&app->scene_mgr);
 
+    // Upscale the canvas to the window once, with an integer scale.
+    SDL_SetRenderTarget(renderer, NULL);
+    SDL_FRect dstrect = {
+        .x = 0,
+        .y = 0,
+        .w = (float)(app->window.logical_w * APPLICATION_SCALE),
+        .h = (float)(app->window.logical_h * APPLICATION_SCALE),
+    };
+    SDL_RenderTexture(renderer, app->scene_mgr.canvas, NULL, &dstrect);
+
     // Present.
-    SDL_RenderPresent(app->window.renderer);
+    SDL_RenderPresent(renderer);
+}
+
+void engine_wait_frame(AppState *app)
+{
+    frame_pacer_wait(&app->pacer);
+}
+
+/**
+ * Opens the asset pack, next to the executable, or in the working directory.
+ */
+bool engine_open_pack(void)
+{
+    char path[1024];
+    if (app_res_path(PACK_FILE_NAME, path, sizeof(path)) && pack_open(path))
+        return true;
+
+    return pack_open(PACK_FILE_NAME);
 }
 
 bool engine_init(AppState *app)
 {
     bool success = true;
 
+    // Without a pack, the assets are read from the loose files instead.
+    if (!engine_open_pack())
+    {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "No asset pack, reading loose asset files");
+    }
+
     if (!font_engine_init(app))
     {
         success = false;
@@ -103,6 +140,20 @@ bool engine_init(AppState *app)
                      "Failed to start font engine");
     }
 
+    if (!assets_init())
+    {
+        success = false;
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to start asset registry");
+    }
+
+    if (!loader_init())
+    {
+        success = false;
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to start asset loader");
+    }
+
     if (!success)
     {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -113,5 +164,8 @@ bool engine_init(AppState *app)
 
 void engine_destroy(void)
 {
+    loader_destroy();
+    assets_destroy();
     font_engine_destroy();
+    pack_close();
 }
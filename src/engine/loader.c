@@ -0,0 +1,349 @@
+#include "engine/loader.h"
+#include "SDL3/SDL_asyncio.h"
+#include "SDL3/SDL_atomic.h"
+#include "SDL3/SDL_cpuinfo.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_mutex.h"
+#include "SDL3/SDL_stdinc.h"
+#include "SDL3/SDL_thread.h"
+#include "SDL3/SDL_timer.h"
+#include "app.h"
+#include "engine/assets.h"
+#include "engine/map.h"
+#include "engine/pack.h"
+#include "engine/sprite.h"
+#include "misc/list.h"
+
+#define LOADER_MAX_WORKERS 4
+
+// Where the background reads complete.
+static SDL_AsyncIOQueue *io_queue = NULL;
+
+// The worker threads, and what they share with the main thread. Workers take
+// from `decode_jobs`, and put what they decoded into `decoded`.
+static SDL_Thread *workers[LOADER_MAX_WORKERS] = {0};
+static int num_workers = 0;
+static SDL_Mutex *lock = NULL;
+static SDL_Condition *has_jobs = NULL;
+static List *decode_jobs = NULL;
+static List *decoded = NULL;
+static bool quitting = false;
+
+// Main thread only. The requests whose textures are being uploaded, and every
+// request that is not finished yet.
+static List *uploading = NULL;
+static List *in_flight = NULL;
+
+/**
+ * Decodes requests on a worker thread, until the loader quits.
+ */
+int loader_worker(void *data)
+{
+    (void)data;
+
+    for (;;)
+    {
+        SDL_LockMutex(lock);
+        while (decode_jobs->length == 0 && !quitting)
+            SDL_WaitCondition(has_jobs, lock);
+
+        if (quitting)
+        {
+            SDL_UnlockMutex(lock);
+            break;
+        }
+
+        LoadRequest *req = decode_jobs->items[0];
+        list_remove_at(decode_jobs, 0);
+        SDL_UnlockMutex(lock);
+
+        // Nothing here touches the renderer.
+        switch (req->type)
+        {
+        case ASSET_TYPE_SPRITE:
+            req->result = sprite_sheet_parse(req->file_data, req->file_size);
+            break;
+        case ASSET_TYPE_MAP:
+            req->result =
+                map_decode(req->file_data, req->file_size, req->name);
+            break;
+        }
+
+        SDL_LockMutex(lock);
+        list_add(decoded, req);
+        SDL_UnlockMutex(lock);
+    }
+
+    return 0;
+}
+
+bool loader_init(void)
+{
+    io_queue = SDL_CreateAsyncIOQueue();
+    lock = SDL_CreateMutex();
+    has_jobs = SDL_CreateCondition();
+    decode_jobs = list_init();
+    decoded = list_init();
+    uploading = list_init();
+    in_flight = list_init();
+    quitting = false;
+
+    if (!io_queue || !lock || !has_jobs)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to create the loader. %s", SDL_GetError());
+        return false;
+    }
+
+    // Leave a core for the main thread.
+    int cores = SDL_GetNumLogicalCPUCores() - 1;
+    num_workers = SDL_clamp(cores, 1, LOADER_MAX_WORKERS);
+    for (int i = 0; i < num_workers; i++)
+    {
+        workers[i] = SDL_CreateThread(loader_worker, "loader", NULL);
+        if (!workers[i])
+        {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Unable to start a loader thread. %s",
+                         SDL_GetError());
+            num_workers = i;
+            break;
+        }
+    }
+
+    return num_workers > 0;
+}
+
+/**
+ * Frees a request, and whatever it still holds.
+ */
+void loader_free_request(LoadRequest *req)
+{
+    if (req->result)
+        assets_free_data(req->type, req->result);
+    if (req->file_owned)
+        SDL_free(req->file_data);
+    SDL_free(req->name);
+    SDL_free(req);
+}
+
+/**
+ * Marks a request as finished. Requests the caller already gave back are
+ * freed right away.
+ */
+void loader_finish(LoadRequest *req, LoadState state)
+{
+    // The decoded asset no longer needs the file, its texture is uploaded.
+    if (req->file_owned)
+        SDL_free(req->file_data);
+    req->file_data = NULL;
+
+    list_remove(in_flight, req);
+    SDL_SetAtomicInt(&req->state, state);
+
+    if (req->released)
+        loader_free_request(req);
+}
+
+LoadRequest *loader_request(AssetType type, const char *name)
+{
+    LoadRequest *req = SDL_calloc(1, sizeof(LoadRequest));
+    req->type = type;
+    req->name = SDL_strdup(name);
+    SDL_SetAtomicInt(&req->state, LOAD_STATE_READING);
+
+    char path[256];
+    assets_get_path(type, name, path, sizeof(path));
+
+    // Files in the pack are already in memory, straight to decoding.
+    req->file_data = (void *)pack_get(path, &req->file_size);
+    if (req->file_data)
+    {
+        SDL_SetAtomicInt(&req->state, LOAD_STATE_DECODING);
+        list_add(in_flight, req);
+
+        SDL_LockMutex(lock);
+        list_add(decode_jobs, req);
+        SDL_UnlockMutex(lock);
+        SDL_SignalCondition(has_jobs);
+        return req;
+    }
+
+    req->file_owned = true;
+    if (!SDL_LoadFileAsync(path, io_queue, req))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Unable to read %s. %s",
+                     path, SDL_GetError());
+        loader_free_request(req);
+        return NULL;
+    }
+
+    list_add(in_flight, req);
+    return req;
+}
+
+LoadState loader_get_state(LoadRequest *req)
+{
+    return (LoadState)SDL_GetAtomicInt(&req->state);
+}
+
+bool loader_is_finished(LoadRequest *req)
+{
+    LoadState state = loader_get_state(req);
+    return state == LOAD_STATE_DONE || state == LOAD_STATE_FAILED;
+}
+
+void *loader_take_result(LoadRequest *req)
+{
+    if (loader_get_state(req) != LOAD_STATE_DONE)
+        return NULL;
+
+    void *result = req->result;
+    req->result = NULL;
+    return result;
+}
+
+void loader_release(LoadRequest *req)
+{
+    if (!req)
+        return;
+
+    if (loader_is_finished(req))
+        loader_free_request(req);
+    else
+        req->released = true;
+}
+
+/**
+ * Hands the finished reads over to the worker threads.
+ */
+void loader_collect_reads(void)
+{
+    SDL_AsyncIOOutcome outcome;
+    bool queued = false;
+
+    while (SDL_GetAsyncIOResult(io_queue, &outcome))
+    {
+        LoadRequest *req = outcome.userdata;
+        if (outcome.result != SDL_ASYNCIO_COMPLETE)
+        {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Unable to read asset %s", req->name);
+            SDL_free(outcome.buffer);
+            loader_finish(req, LOAD_STATE_FAILED);
+            continue;
+        }
+
+        req->file_data = outcome.buffer;
+        req->file_size = (size_t)outcome.bytes_transferred;
+        SDL_SetAtomicInt(&req->state, LOAD_STATE_DECODING);
+
+        SDL_LockMutex(lock);
+        list_add(decode_jobs, req);
+        SDL_UnlockMutex(lock);
+        queued = true;
+    }
+
+    if (queued)
+        SDL_BroadcastCondition(has_jobs);
+}
+
+/**
+ * Uploads a slice of a decoded request. Returns true when it's finished.
+ */
+bool loader_upload(LoadRequest *req)
+{
+    if (!req->result)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to decode asset %s", req->name);
+        loader_finish(req, LOAD_STATE_FAILED);
+        return true;
+    }
+
+    if (req->type == ASSET_TYPE_SPRITE &&
+        !sprite_sheet_upload(req->result, app_get()->window.renderer,
+                             LOADER_UPLOAD_ROWS))
+        return false;
+
+    loader_finish(req, LOAD_STATE_DONE);
+    return true;
+}
+
+void loader_update(Uint64 budget_ns)
+{
+    Uint64 deadline = SDL_GetTicksNS() + budget_ns;
+
+    loader_collect_reads();
+
+    SDL_LockMutex(lock);
+    for (Uint32 i = 0; i < decoded->length; i++)
+    {
+        LoadRequest *req = decoded->items[i];
+        SDL_SetAtomicInt(&req->state, LOAD_STATE_UPLOADING);
+        list_add(uploading, req);
+    }
+    list_clear(decoded);
+    SDL_UnlockMutex(lock);
+
+    // Upload in order, so the oldest requests finish first.
+    while (uploading->length > 0 && SDL_GetTicksNS() < deadline)
+    {
+        LoadRequest *req = uploading->items[0];
+        if (loader_upload(req))
+            list_remove_at(uploading, 0);
+    }
+}
+
+void loader_destroy(void)
+{
+    if (lock)
+    {
+        SDL_LockMutex(lock);
+        quitting = true;
+        SDL_UnlockMutex(lock);
+        SDL_BroadcastCondition(has_jobs);
+    }
+
+    for (int i = 0; i < num_workers; i++)
+        SDL_WaitThread(workers[i], NULL);
+    num_workers = 0;
+
+    // Wait for the reads still going, as they write into the requests.
+    while (io_queue)
+    {
+        bool reading = false;
+        for (Uint32 i = 0; i < in_flight->length; i++)
+        {
+            LoadRequest *req = in_flight->items[i];
+            reading = reading || loader_get_state(req) == LOAD_STATE_READING;
+        }
+        if (!reading)
+            break;
+
+        SDL_AsyncIOOutcome outcome;
+        if (!SDL_WaitAsyncIOResult(io_queue, &outcome, -1))
+            break;
+
+        LoadRequest *req = outcome.userdata;
+        req->file_data = outcome.buffer;
+        SDL_SetAtomicInt(&req->state, LOAD_STATE_DECODING);
+    }
+
+    // Everything still in flight is dropped, released or not.
+    for (Uint32 i = 0; in_flight && i < in_flight->length; i++)
+        loader_free_request(in_flight->items[i]);
+
+    SDL_DestroyAsyncIOQueue(io_queue);
+    SDL_DestroyCondition(has_jobs);
+    SDL_DestroyMutex(lock);
+    list_destroy(decode_jobs);
+    list_destroy(decoded);
+    list_destroy(uploading);
+    list_destroy(in_flight);
+
+    io_queue = NULL;
+    has_jobs = NULL;
+    lock = NULL;
+    decode_jobs = decoded = uploading = in_flight = NULL;
+}
@@ -1,121 +1,703 @@
 #include "engine/map.h"
+#include "SDL3/SDL_asyncio.h"
 #include "SDL3/SDL_iostream.h"
 #include "SDL3/SDL_log.h"
 #include "SDL3/SDL_stdinc.h"
+#include "engine/pack.h"
 #include "engine/sprite.h"
 
-int map_compute_index(Map *map, Uint32 x, Uint32 y)
+// The largest map that is loaded, in tiles, and the longest name it can have.
+#define MAP_MAX_TILES (1u << 24)
+#define MAP_MAX_NAME_LEN 256
+
+// The fixed sizes of the version 2 header and of a chunk index entry, in bytes.
+#define MAP_V2_HEADER_SIZE 28
+#define MAP_V2_CHUNK_SIZE 12
+
+// The largest chunk side a version 2 file can have.
+#define MAP_MAX_CHUNK_SIZE 256
+
+/**
+ * Represents how a chunk of a version 2 map is stored.
+ */
+typedef enum
 {
-    if (x >= map->w || y >= map->h)
-        return -1;
-    return (int)(y * map->w + x);
+    MAP_CHUNK_EMPTY = 0, // Only air, nothing is stored.
+    MAP_CHUNK_RAW = 1,   // A byte per tile, row by row.
+    MAP_CHUNK_RLE = 2,   // Pairs of (run length, tile) bytes.
+} MapChunkEncoding;
+
+/**
+ * Represents the header of a version 2 map file.
+ */
+typedef struct
+{
+    Uint32 w;
+    Uint32 h;
+    Uint32 chunk_size;
+    Uint32 name_len;
+    Uint32 name_at;
+    Uint32 chunks_at;
+} MapHeader;
+
+/**
+ * Represents where a chunk of a streamed map is at.
+ */
+typedef enum
+{
+    MAP_STREAM_UNLOADED, // Not in memory.
+    MAP_STREAM_LOADING,  // Being read from the disk.
+    MAP_STREAM_LOADED,   // In memory, or only air.
+} MapStreamState;
+
+/**
+ * Represents the streaming state of a map.
+ */
+typedef struct MapStream
+{
+    const Uint8 *data; // The map file, when it's in the pack.
+    Uint64 size;
+    SDL_AsyncIO *file; // The map file otherwise, read chunk by chunk.
+    SDL_AsyncIOQueue *queue;
+    Uint32 num_loading;
+
+    Uint8 *index;  // The chunk index, copied out of the file.
+    Uint8 *states; // The MapStreamState of every chunk.
+
+    Uint64 updates;        // How many times the stream was updated.
+    double last_x, last_y; // The focus at the last update.
+} MapStream;
+
+// Tiles are packed into the high nibble of a cell.
+SDL_COMPILE_TIME_ASSERT(map_tiles, NUM_MAP_TILES <= 16);
+
+// A chunk's row, and a tile on either side of it, fits in a row bit mask.
+SDL_COMPILE_TIME_ASSERT(map_chunk_rows, MAP_CHUNK_SIZE + 2 <= 64);
+
+MapChunk *map_get_chunk(const Map *map, Sint64 cx, Sint64 cy)
+{
+    if (cx < 0 || cy < 0 || cx >= map->chunks_w || cy >= map->chunks_h)
+        return NULL;
+
+    return hash_map_get(map->chunks, (Uint32)(cy * map->chunks_w + cx));
+}
+
+MapNode map_get_node(const Map *map, Sint64 x, Sint64 y)
+{
+    MapNode node = {.tile = TILE_AIR, .dir = 0};
+    if (x < 0 || y < 0 || x >= map->w || y >= map->h)
+        return node;
+
+    const MapChunk *chunk =
+        map_get_chunk(map, x / MAP_CHUNK_SIZE, y / MAP_CHUNK_SIZE);
+    if (!chunk)
+        return node;
+
+    MapCell cell = chunk->cells[(y % MAP_CHUNK_SIZE) * MAP_CHUNK_SIZE +
+                                x % MAP_CHUNK_SIZE];
+    node.tile = MAP_CELL_TILE(cell);
+    node.dir = MAP_CELL_DIR(cell);
+    return node;
 }
 
 /**
- * Rescans the map tiles and checks for neighbors.
+ * Retrieves a tile next to a chunk. `near` holds the chunk, then the ones to
+ * its north, south, west and east, and (x, y) can be one tile off the chunk.
  */
-void map_autotile(Map *map)
+MapTile map_chunk_peek(const MapChunk *const near[5], int x, int y)
+{
+    const MapChunk *chunk = near[0];
+    if (y < 0)
+    {
+        chunk = near[1];
+        y += MAP_CHUNK_SIZE;
+    }
+    else if (y >= MAP_CHUNK_SIZE)
+    {
+        chunk = near[2];
+        y -= MAP_CHUNK_SIZE;
+    }
+    else if (x < 0)
+    {
+        chunk = near[3];
+        x += MAP_CHUNK_SIZE;
+    }
+    else if (x >= MAP_CHUNK_SIZE)
+    {
+        chunk = near[4];
+        x -= MAP_CHUNK_SIZE;
+    }
+
+    return chunk ? MAP_CELL_TILE(chunk->cells[y * MAP_CHUNK_SIZE + x])
+                 : TILE_AIR;
+}
+
+/**
+ * Recomputes the neighbors of the tiles of a chunk from (x0, y0) up to
+ * (x1, y1) excluded, in the chunk's own coordinates.
+ */
+void map_autotile_chunk(Map *map, MapChunk *chunk, int x0, int y0, int x1,
+                        int y1)
+{
+    // The neighbors are looked up once for the whole chunk.
+    Sint64 cx = chunk->cx, cy = chunk->cy;
+    const MapChunk *const near[5] = {
+        chunk,
+        map_get_chunk(map, cx, cy - 1),
+        map_get_chunk(map, cx, cy + 1),
+        map_get_chunk(map, cx - 1, cy),
+        map_get_chunk(map, cx + 1, cy),
+    };
+
+    for (int y = y0; y < y1; y++)
+    {
+        for (int x = x0; x < x1; x++)
+        {
+            MapTile tile = MAP_CELL_TILE(chunk->cells[y * MAP_CHUNK_SIZE + x]);
+            int dir = 0;
+            if (map_chunk_peek(near, x, y - 1) == tile)
+                dir |= NODE_DIR_N;
+            if (map_chunk_peek(near, x, y + 1) == tile)
+                dir |= NODE_DIR_S;
+            if (map_chunk_peek(near, x - 1, y) == tile)
+                dir |= NODE_DIR_W;
+            if (map_chunk_peek(near, x + 1, y) == tile)
+                dir |= NODE_DIR_E;
+            chunk->cells[y * MAP_CHUNK_SIZE + x] = MAP_CELL(tile, dir);
+        }
+    }
+}
+
+/**
+ * Recomputes the neighbors of every tile of a chunk at once. Each tile type
+ * gets a bit mask per row, with the chunk's columns in bits 1 to
+ * MAP_CHUNK_SIZE and the edges of the chunks west and east of it around
+ * them, so the neighbors of a whole row are found with a few shifts and ANDs.
+ */
+void map_autotile_chunk_rows(Map *map, MapChunk *chunk)
 {
-    for (Uint32 y = 0; y < map->h; y++)
+    Sint64 cx = chunk->cx, cy = chunk->cy;
+    const MapChunk *north = map_get_chunk(map, cx, cy - 1);
+    const MapChunk *south = map_get_chunk(map, cx, cy + 1);
+    const MapChunk *west = map_get_chunk(map, cx - 1, cy);
+    const MapChunk *east = map_get_chunk(map, cx + 1, cy);
+
+    // Rows 0 and MAP_CHUNK_SIZE + 1 are the edges of the chunks north and
+    // south of it.
+    Uint64 rows[NUM_MAP_TILES][MAP_CHUNK_SIZE + 2] = {0};
+    Uint16 present = 0;
+
+    for (int y = 0; y < MAP_CHUNK_SIZE; y++)
     {
-        for (Uint32 x = 0; x < map->w; x++)
+        const MapCell *cells = &chunk->cells[y * MAP_CHUNK_SIZE];
+        for (int x = 0; x < MAP_CHUNK_SIZE; x++)
         {
-            int idx = map_compute_index(map, x, y);
-            int north = map_compute_index(map, x, y - 1);
-            int south = map_compute_index(map, x, y + 1);
-            int east = map_compute_index(map, x + 1, y);
-            int west = map_compute_index(map, x - 1, y);
+            MapTile tile = MAP_CELL_TILE(cells[x]);
+            rows[tile][y + 1] |= (Uint64)1 << (x + 1);
+            present |= 1 << tile;
+        }
 
-            MapTile val = map->tiles[idx].tile;
-            map->tiles[idx].dir = 0;
+        MapTile left =
+            west ? MAP_CELL_TILE(west->cells[y * MAP_CHUNK_SIZE +
+                                             MAP_CHUNK_SIZE - 1])
+                 : TILE_AIR;
+        MapTile right =
+            east ? MAP_CELL_TILE(east->cells[y * MAP_CHUNK_SIZE]) : TILE_AIR;
+        rows[left][y + 1] |= 1;
+        rows[right][y + 1] |= (Uint64)1 << (MAP_CHUNK_SIZE + 1);
+    }
 
-            if (north >= 0 && map->tiles[north].tile == val)
-            {
-                map->tiles[idx].dir |= NODE_DIR_N;
-            }
-            if (south >= 0 && map->tiles[south].tile == val)
-            {
-                map->tiles[idx].dir |= NODE_DIR_S;
-            }
-            if (west >= 0 && map->tiles[west].tile == val)
-            {
-                map->tiles[idx].dir |= NODE_DIR_W;
-            }
-            if (east >= 0 && map->tiles[east].tile == val)
-            {
-                map->tiles[idx].dir |= NODE_DIR_E;
-            }
+    for (int x = 0; x < MAP_CHUNK_SIZE; x++)
+    {
+        MapTile above =
+            north ? MAP_CELL_TILE(
+                        north->cells[(MAP_CHUNK_SIZE - 1) * MAP_CHUNK_SIZE + x])
+                  : TILE_AIR;
+        MapTile below = south ? MAP_CELL_TILE(south->cells[x]) : TILE_AIR;
+        rows[above][0] |= (Uint64)1 << (x + 1);
+        rows[below][MAP_CHUNK_SIZE + 1] |= (Uint64)1 << (x + 1);
+    }
+
+    // A tile has a neighbor where its type's mask is set on both. Every tile
+    // has a single type, so the types are simply merged.
+    Uint64 n[MAP_CHUNK_SIZE] = {0}, s[MAP_CHUNK_SIZE] = {0};
+    Uint64 w[MAP_CHUNK_SIZE] = {0}, e[MAP_CHUNK_SIZE] = {0};
+    for (int tile = 0; tile < NUM_MAP_TILES; tile++)
+    {
+        if (!(present & (1 << tile)))
+            continue;
+
+        const Uint64 *mask = rows[tile];
+        for (int y = 0; y < MAP_CHUNK_SIZE; y++)
+        {
+            Uint64 row = mask[y + 1];
+            n[y] |= row & mask[y];
+            s[y] |= row & mask[y + 2];
+            w[y] |= row & (row << 1);
+            e[y] |= row & (row >> 1);
+        }
+    }
+
+    for (int y = 0; y < MAP_CHUNK_SIZE; y++)
+    {
+        MapCell *cells = &chunk->cells[y * MAP_CHUNK_SIZE];
+        for (int x = 0; x < MAP_CHUNK_SIZE; x++)
+        {
+            int bit = x + 1;
+            int dir = (int)((n[y] >> bit) & 1) * NODE_DIR_N |
+                      (int)((s[y] >> bit) & 1) * NODE_DIR_S |
+                      (int)((w[y] >> bit) & 1) * NODE_DIR_W |
+                      (int)((e[y] >> bit) & 1) * NODE_DIR_E;
+            cells[x] = MAP_CELL(MAP_CELL_TILE(cells[x]), dir);
+        }
+    }
+}
+
+/**
+ * Recomputes the neighbors of the tiles from (x0, y0) up to (x1, y1)
+ * excluded. The region is clamped to the map, and chunks that are not in
+ * memory are skipped.
+ */
+void map_autotile_region(Map *map, Sint64 x0, Sint64 y0, Sint64 x1, Sint64 y1)
+{
+    x0 = SDL_max(x0, 0);
+    y0 = SDL_max(y0, 0);
+    x1 = SDL_min(x1, (Sint64)map->w);
+    y1 = SDL_min(y1, (Sint64)map->h);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    for (Sint64 cy = y0 / MAP_CHUNK_SIZE; cy <= (y1 - 1) / MAP_CHUNK_SIZE;
+         cy++)
+    {
+        for (Sint64 cx = x0 / MAP_CHUNK_SIZE; cx <= (x1 - 1) / MAP_CHUNK_SIZE;
+             cx++)
+        {
+            MapChunk *chunk = map_get_chunk(map, cx, cy);
+            if (!chunk)
+                continue;
+
+            // The part of the region inside of this chunk.
+            Sint64 left = cx * MAP_CHUNK_SIZE, top = cy * MAP_CHUNK_SIZE;
+            int lx0 = (int)(SDL_max(x0, left) - left);
+            int ly0 = (int)(SDL_max(y0, top) - top);
+            int lx1 = (int)(SDL_min(x1, left + MAP_CHUNK_SIZE) - left);
+            int ly1 = (int)(SDL_min(y1, top + MAP_CHUNK_SIZE) - top);
+
+            if (lx0 == 0 && ly0 == 0 && lx1 == MAP_CHUNK_SIZE &&
+                ly1 == MAP_CHUNK_SIZE)
+                map_autotile_chunk_rows(map, chunk);
+            else
+                map_autotile_chunk(map, chunk, lx0, ly0, lx1, ly1);
         }
     }
 }
 
+/**
+ * Rescans the map tiles and checks for neighbors.
+ */
+void map_autotile(Map *map)
+{
+    for (Uint32 i = 0; i < map->num_chunks; i++)
+        map_autotile_chunk_rows(map, map->chunk_list[i]);
+}
+
+/**
+ * Retrieves a chunk, creating it with only air if it's not there.
+ */
+MapChunk *map_chunk_ensure(Map *map, Uint32 cx, Uint32 cy)
+{
+    MapChunk *chunk = map_get_chunk(map, cx, cy);
+    if (chunk)
+        return chunk;
+
+    if (map->num_chunks == map->cap_chunks)
+    {
+        map->cap_chunks = SDL_max(map->cap_chunks * 2, 16);
+        map->chunk_list = SDL_realloc(map->chunk_list,
+                                      map->cap_chunks * sizeof(MapChunk *));
+    }
+
+    // Air is 0, so this is an empty chunk already.
+    chunk = SDL_calloc(1, sizeof(MapChunk));
+    chunk->cx = cx;
+    chunk->cy = cy;
+    chunk->slot = map->num_chunks;
+    chunk->last_used = map->stream ? map->stream->updates : 0;
+    map->chunk_list[map->num_chunks++] = chunk;
+    hash_map_put(map->chunks, cy * map->chunks_w + cx, chunk);
+    return chunk;
+}
+
+/**
+ * Frees a chunk, so its tiles are air again.
+ */
+void map_chunk_free(Map *map, MapChunk *chunk)
+{
+    hash_map_remove(map->chunks, chunk->cy * map->chunks_w + chunk->cx);
+
+    // Swap the last chunk of the list in its place.
+    MapChunk *last = map->chunk_list[--map->num_chunks];
+    map->chunk_list[chunk->slot] = last;
+    last->slot = chunk->slot;
+    SDL_free(chunk);
+}
+
+/**
+ * Puts a tile into the map, without autotiling. Chunks are only created for
+ * tiles that are not air.
+ */
+void map_put_tile(Map *map, Uint32 x, Uint32 y, MapTile tile)
+{
+    Uint32 cx = x / MAP_CHUNK_SIZE, cy = y / MAP_CHUNK_SIZE;
+    MapChunk *chunk = map_get_chunk(map, cx, cy);
+    if (!chunk && tile == TILE_AIR)
+        return;
+    if (!chunk)
+        chunk = map_chunk_ensure(map, cx, cy);
+
+    Uint32 lx = x % MAP_CHUNK_SIZE, ly = y % MAP_CHUNK_SIZE;
+    MapCell *cell = &chunk->cells[ly * MAP_CHUNK_SIZE + lx];
+    chunk->num_tiles += (tile != TILE_AIR) - (MAP_CELL_TILE(*cell) != TILE_AIR);
+    *cell = MAP_CELL(tile, 0);
+}
+
+/**
+ * Tells the listeners that tiles from (x0, y0) up to (x1, y1) excluded
+ * changed. The region is clamped to the map.
+ */
+void map_notify(Map *map, Sint64 x0, Sint64 y0, Sint64 x1, Sint64 y1)
+{
+    x0 = SDL_max(x0, 0);
+    y0 = SDL_max(y0, 0);
+    x1 = SDL_min(x1, (Sint64)map->w);
+    y1 = SDL_min(y1, (Sint64)map->h);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    MapRegion region = {
+        .x = (Uint32)x0,
+        .y = (Uint32)y0,
+        .w = (Uint32)(x1 - x0),
+        .h = (Uint32)(y1 - y0),
+    };
+    for (Uint32 i = 0; i < map->num_listeners; i++)
+    {
+        map->listeners[i].callback(map, region, map->listeners[i].userdata);
+    }
+}
+
+bool map_set_tile(Map *map, Uint32 x, Uint32 y, MapTile tile)
+{
+    if (x >= map->w || y >= map->h || tile >= NUM_MAP_TILES)
+        return false;
+
+    // A streamed chunk that isn't in memory yet would either be read over the
+    // edit, or never be read at all once the edit created it.
+    Uint32 cx = x / MAP_CHUNK_SIZE, cy = y / MAP_CHUNK_SIZE;
+    if (map->stream &&
+        map->stream->states[cy * map->chunks_w + cx] != MAP_STREAM_LOADED)
+        return false;
+
+    if (map_get_node(map, x, y).tile == tile)
+        return true;
+
+    map_put_tile(map, x, y, tile);
+
+    // Only the tile and the 4 around it can see a different neighbor.
+    map_autotile_region(map, (Sint64)x - 1, (Sint64)y - 1, (Sint64)x + 2,
+                        (Sint64)y + 2);
+
+    // A chunk that went back to only air is dropped.
+    MapChunk *chunk = map_get_chunk(map, cx, cy);
+    if (chunk && chunk->num_tiles == 0)
+        map_chunk_free(map, chunk);
+
+    map_notify(map, (Sint64)x - 1, (Sint64)y - 1, (Sint64)x + 2, (Sint64)y + 2);
+    return true;
+}
+
+void map_add_listener(Map *map, MapListener callback, void *userdata)
+{
+    if (map->num_listeners == map->cap_listeners)
+    {
+        map->cap_listeners = SDL_max(map->cap_listeners * 2, 4);
+        map->listeners = SDL_realloc(
+            map->listeners, map->cap_listeners * sizeof(MapListenerEntry));
+    }
+
+    map->listeners[map->num_listeners++] = (MapListenerEntry){
+        .callback = callback,
+        .userdata = userdata,
+    };
+}
+
+void map_remove_listener(Map *map, MapListener callback, void *userdata)
+{
+    for (Uint32 i = 0; i < map->num_listeners; i++)
+    {
+        MapListenerEntry *entry = &map->listeners[i];
+        if (entry->callback != callback || entry->userdata != userdata)
+            continue;
+
+        SDL_memmove(entry, entry + 1,
+                    (map->num_listeners - i - 1) * sizeof(MapListenerEntry));
+        map->num_listeners--;
+        return;
+    }
+}
+
+/**
+ * Allocates a map of the given size, with only air tiles. Returns NULL if the
+ * size is unreasonable.
+ */
+Map *map_alloc(char *name, Uint32 w, Uint32 h)
+{
+    if (w == 0 || h == 0 || (Uint64)w * h > MAP_MAX_TILES)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Invalid map size %ux%u for %s", w, h, name);
+        return NULL;
+    }
+
+    // Nothing but air yet, chunks come with their first tile.
+    Map *map = SDL_calloc(1, sizeof(Map));
+    map->name = name;
+    map->w = w;
+    map->h = h;
+    map->chunks_w = (w + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    map->chunks_h = (h + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    map->chunks = hash_map_init();
+    return map;
+}
+
 /**
  * Initializes the map from the version 1 of the file.
  */
 Map *map_init_v1(SDL_IOStream *io)
 {
-    Map *map = SDL_malloc(sizeof(Map));
-
     // Read the map's name.
     Uint32 name_len;
-    SDL_ReadU32LE(io, &name_len);
-    char *buf = SDL_calloc(name_len + 1, sizeof(char));
-    SDL_ReadIO(io, buf, name_len);
-    map->name = buf;
+    if (!SDL_ReadU32LE(io, &name_len) || name_len > MAP_MAX_NAME_LEN)
+        return NULL;
+
+    char *name = SDL_calloc(name_len + 1, sizeof(char));
+    if (SDL_ReadIO(io, name, name_len) != name_len)
+    {
+        SDL_free(name);
+        return NULL;
+    }
 
     // Read the max size of the map coords.
-    SDL_ReadU32LE(io, &map->w);
-    SDL_ReadU32LE(io, &map->h);
+    Uint32 w, h;
+    if (!SDL_ReadU32LE(io, &w) || !SDL_ReadU32LE(io, &h))
+    {
+        SDL_free(name);
+        return NULL;
+    }
 
-    // Construct the map's matrix of nodes.
-    map->tiles = SDL_malloc(map->w * map->h * sizeof(MapNode));
-    for (Uint32 i = 0; i < map->w * map->h; i++)
+    Map *map = map_alloc(name, w, h);
+    if (!map)
     {
-        map->tiles[i].dir = 0;
-        map->tiles[i].tile = TILE_AIR;
+        SDL_free(name);
+        return NULL;
     }
 
-    // Read the coord list.
+    // Read the coord list. Every coord is checked, a broken file can't write
+    // outside of the map.
     Uint32 coords_len;
-    SDL_ReadU32LE(io, &coords_len);
+    if (!SDL_ReadU32LE(io, &coords_len))
+    {
+        map_destroy(map);
+        return NULL;
+    }
+
     for (Uint32 i = 0; i < coords_len; i++)
     {
         Uint32 x, y, v;
-        SDL_ReadU32LE(io, &x);
-        SDL_ReadU32LE(io, &y);
-        SDL_ReadU32LE(io, &v);
+        if (!SDL_ReadU32LE(io, &x) || !SDL_ReadU32LE(io, &y) ||
+            !SDL_ReadU32LE(io, &v) || x >= w || y >= h || v >= NUM_MAP_TILES)
+        {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Invalid tile %u in map %s", i, map->name);
+            map_destroy(map);
+            return NULL;
+        }
 
-        map->tiles[y * map->w + x].tile = (MapTile)v;
+        map_put_tile(map, x, y, (MapTile)v);
     }
 
     map_autotile(map);
     return map;
 }
 
-Map *map_init(const char *name)
+/**
+ * Reads a little endian u32 from a map file.
+ */
+Uint32 map_read_u32(const Uint8 *data)
 {
-    SDL_Log("Attempting to load map %s", name);
+    Uint32 value;
+    SDL_memcpy(&value, data, sizeof(value));
+    return SDL_Swap32LE(value);
+}
 
-    char buf[256] = "assets/map/";
-    SDL_strlcat(buf, name, sizeof(buf));
-    SDL_strlcat(buf, ".map", sizeof(buf));
+/**
+ * Reads and checks the header of a version 2 map file of `size` bytes.
+ */
+bool map_read_header(const Uint8 *data, Uint64 size, MapHeader *header)
+{
+    if (size < MAP_V2_HEADER_SIZE)
+        return false;
 
-    SDL_IOStream *io = SDL_IOFromFile(buf, "rb");
-    if (io == NULL)
+    header->w = map_read_u32(data + 4);
+    header->h = map_read_u32(data + 8);
+    header->chunk_size = map_read_u32(data + 12);
+    header->name_len = map_read_u32(data + 16);
+    header->name_at = map_read_u32(data + 20);
+    header->chunks_at = map_read_u32(data + 24);
+    if (header->chunk_size == 0 || header->chunk_size > MAP_MAX_CHUNK_SIZE ||
+        header->name_len > MAP_MAX_NAME_LEN ||
+        (Uint64)header->name_at + header->name_len > size)
+        return false;
+
+    Uint64 chunks_w =
+        (header->w + (Uint64)header->chunk_size - 1) / header->chunk_size;
+    Uint64 chunks_h =
+        (header->h + (Uint64)header->chunk_size - 1) / header->chunk_size;
+    return header->chunks_at + chunks_w * chunks_h * MAP_V2_CHUNK_SIZE <= size;
+}
+
+/**
+ * Decodes a chunk of a version 2 map into its tiles. The chunk starts at the
+ * tile (x, y), and is `w` by `h` tiles, as chunks on the edges are cut off.
+ *
+ * Returns false if the chunk is broken.
+ */
+bool map_decode_chunk(Map *map, Uint32 x, Uint32 y, Uint32 w, Uint32 h,
+                      Uint32 encoding, const Uint8 *data, Uint32 size)
+{
+    Uint32 count = w * h;
+    switch (encoding)
+    {
+    case MAP_CHUNK_EMPTY:
+        return size == 0;
+    case MAP_CHUNK_RAW:
+        if (size != count)
+            return false;
+
+        for (Uint32 row = 0; row < h; row++, data += w)
+        {
+            for (Uint32 col = 0; col < w; col++)
+            {
+                if (data[col] >= NUM_MAP_TILES)
+                    return false;
+                map_put_tile(map, x + col, y + row, (MapTile)data[col]);
+            }
+        }
+        return true;
+    case MAP_CHUNK_RLE:
+        // Runs of (length, tile) byte pairs, that cover the chunk exactly.
+        if (size % 2 != 0)
+            return false;
+
+        Uint32 at = 0;
+        for (Uint32 i = 0; i < size; i += 2)
+        {
+            Uint32 run = data[i];
+            MapTile tile = (MapTile)data[i + 1];
+            if (run == 0 || run > count - at || tile >= NUM_MAP_TILES)
+                return false;
+
+            // Air is there already.
+            if (tile == TILE_AIR)
+            {
+                at += run;
+                continue;
+            }
+
+            for (; run > 0; run--, at++)
+                map_put_tile(map, x + at % w, y + at / w, tile);
+        }
+        return at == count;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Initializes the map from the version 2 of the file, that is already in
+ * memory. Tiles are stored by chunks, found through an index, so everything is
+ * read straight out of the buffer.
+ */
+Map *map_init_v2(const Uint8 *data, size_t size, const char *file)
+{
+    MapHeader header;
+    if (!map_read_header(data, size, &header))
     {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "Can't find map file of name %s", name);
+                     "Invalid header in map file %s", file);
+        return NULL;
+    }
+
+    char *name =
+        SDL_strndup((const char *)data + header.name_at, header.name_len);
+    Map *map = map_alloc(name, header.w, header.h);
+    if (!map)
+    {
+        SDL_free(name);
         return NULL;
     }
 
+    Uint32 chunk_size = header.chunk_size;
+    Uint32 chunks_w = (header.w + chunk_size - 1) / chunk_size;
+    Uint32 chunks_h = (header.h + chunk_size - 1) / chunk_size;
+
+    const Uint8 *chunk = data + header.chunks_at;
+    for (Uint32 cy = 0; cy < chunks_h; cy++)
+    {
+        for (Uint32 cx = 0; cx < chunks_w; cx++, chunk += MAP_V2_CHUNK_SIZE)
+        {
+            Uint32 at = map_read_u32(chunk);
+            Uint32 len = map_read_u32(chunk + 4);
+            Uint32 encoding = map_read_u32(chunk + 8);
+
+            Uint32 x = cx * chunk_size, y = cy * chunk_size;
+            Uint32 cw = SDL_min(chunk_size, header.w - x);
+            Uint32 ch = SDL_min(chunk_size, header.h - y);
+            if ((Uint64)at + len > size ||
+                !map_decode_chunk(map, x, y, cw, ch, encoding, data + at, len))
+            {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                             "Invalid chunk (%u, %u) in map file %s", cx, cy,
+                             file);
+                map_destroy(map);
+                return NULL;
+            }
+        }
+    }
+
+    map_autotile(map);
+    return map;
+}
+
+/**
+ * Reads a map of any known version from a stream.
+ */
+Map *map_read(SDL_IOStream *io, const char *name)
+{
     Map *map = NULL;
-    Uint32 version;
+    Uint32 version = 0;
     SDL_ReadU32LE(io, &version);
 
     switch (version)
     {
     case 1:
         map = map_init_v1(io);
+        if (!map)
+        {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Map file %s is broken", name);
+        }
         break;
     default:
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -123,20 +705,416 @@ Map *map_init(const char *name)
         break;
     }
 
+    return map;
+}
+
+/**
+ * Builds the path of a map's file.
+ */
+void map_get_path(const char *name, char *buf, size_t size)
+{
+    SDL_snprintf(buf, size, "assets/map/%s.map", name);
+}
+
+Map *map_init(const char *name)
+{
+    SDL_Log("Attempting to load map %s", name);
+
+    char buf[256];
+    map_get_path(name, buf, sizeof(buf));
+
+    size_t size = 0;
+    bool owned = false;
+    void *data = pack_read(buf, &size, &owned);
+    if (data == NULL)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Can't find map file of name %s", name);
+        return NULL;
+    }
+
+    Map *map = map_decode(data, size, name);
+    if (owned)
+        SDL_free(data);
+    return map;
+}
+
+Map *map_decode(const void *data, size_t size, const char *name)
+{
+    // Version 2 is decoded from memory, without going through a stream.
+    if (size >= 4 && map_read_u32(data) == 2)
+        return map_init_v2(data, size, name);
+
+    SDL_IOStream *io = SDL_IOFromConstMem(data, size);
+    if (io == NULL)
+        return NULL;
+
+    Map *map = map_read(io, name);
     SDL_CloseIO(io);
     return map;
 }
 
-void map_tile_sprite(Sprite *spr, MapTile tile)
+/**
+ * Reads part of a map file, out of the pack if `data` is set, or from the
+ * stream otherwise.
+ */
+bool map_stream_read(const Uint8 *data, Uint64 size, SDL_IOStream *io,
+                     Uint64 at, void *buf, size_t len)
+{
+    if (at + len > size)
+        return false;
+    if (data)
+    {
+        SDL_memcpy(buf, data + at, len);
+        return true;
+    }
+
+    return SDL_SeekIO(io, (Sint64)at, SDL_IO_SEEK_SET) >= 0 &&
+           SDL_ReadIO(io, buf, len) == len;
+}
+
+/**
+ * Reads the chunk index of a map file to stream. Returns NULL if the file
+ * can't be streamed.
+ */
+Map *map_stream_read_index(const Uint8 *data, Uint64 size, SDL_IOStream *io,
+                           const char *file)
+{
+    Uint8 bytes[MAP_V2_HEADER_SIZE];
+    MapHeader header;
+    if (!map_stream_read(data, size, io, 0, bytes, sizeof(bytes)) ||
+        map_read_u32(bytes) != 2 || !map_read_header(bytes, size, &header) ||
+        header.chunk_size != MAP_CHUNK_SIZE)
+        return NULL;
+
+    char *name = SDL_calloc(header.name_len + 1, sizeof(char));
+    if (!map_stream_read(data, size, io, header.name_at, name,
+                         header.name_len))
+    {
+        SDL_free(name);
+        return NULL;
+    }
+
+    Map *map = map_alloc(name, header.w, header.h);
+    if (!map)
+    {
+        SDL_free(name);
+        return NULL;
+    }
+
+    Uint32 num_chunks = map->chunks_w * map->chunks_h;
+    MapStream *stream = SDL_calloc(1, sizeof(MapStream));
+    stream->index = SDL_malloc((size_t)num_chunks * MAP_V2_CHUNK_SIZE);
+    stream->states = SDL_calloc(num_chunks, sizeof(Uint8));
+    map->stream = stream;
+    if (!map_stream_read(data, size, io, header.chunks_at, stream->index,
+                         (size_t)num_chunks * MAP_V2_CHUNK_SIZE))
+    {
+        map_destroy(map);
+        return NULL;
+    }
+
+    // Check the whole index now, so chunks can be read blindly later.
+    for (Uint32 i = 0; i < num_chunks; i++)
+    {
+        const Uint8 *entry = stream->index + (size_t)i * MAP_V2_CHUNK_SIZE;
+        Uint32 at = map_read_u32(entry);
+        Uint32 len = map_read_u32(entry + 4);
+        Uint32 encoding = map_read_u32(entry + 8);
+        if ((Uint64)at + len > size || (encoding != MAP_CHUNK_EMPTY && !len))
+        {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Invalid chunk %u in map file %s", i, file);
+            map_destroy(map);
+            return NULL;
+        }
+
+        // Chunks of air have nothing to load.
+        if (encoding == MAP_CHUNK_EMPTY)
+            stream->states[i] = MAP_STREAM_LOADED;
+    }
+
+    stream->size = size;
+    return map;
+}
+
+Map *map_stream_open(const char *name)
+{
+    char path[256];
+    map_get_path(name, path, sizeof(path));
+
+    // In the pack, chunks are decoded straight out of the mapped file.
+    size_t size = 0;
+    const Uint8 *data = pack_get(path, &size);
+    if (data)
+    {
+        Map *map = map_stream_read_index(data, size, NULL, name);
+        if (!map)
+        {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Map %s can't be streamed, loading it whole", name);
+            return map_init(name);
+        }
+
+        map->stream->data = data;
+        return map;
+    }
+
+    SDL_IOStream *io = SDL_IOFromFile(path, "rb");
+    if (!io)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Can't find map file of name %s", name);
+        return NULL;
+    }
+
+    Sint64 file_size = SDL_GetIOSize(io);
+    Map *map = file_size < 0 ? NULL
+                             : map_stream_read_index(NULL, (Uint64)file_size,
+                                                     io, name);
+    SDL_CloseIO(io);
+    if (!map)
+    {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Map %s can't be streamed, loading it whole", name);
+        return map_init(name);
+    }
+
+    // Otherwise chunks are read in the background.
+    MapStream *stream = map->stream;
+    stream->file = SDL_AsyncIOFromFile(path, "r");
+    stream->queue = SDL_CreateAsyncIOQueue();
+    if (!stream->file || !stream->queue)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to stream map %s. %s", name, SDL_GetError());
+        map_destroy(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+/**
+ * Decodes a chunk of a streamed map that was just read, and fixes up the
+ * edges of the chunks around it.
+ */
+void map_stream_place(Map *map, Uint32 idx, const Uint8 *data, Uint32 size)
+{
+    MapStream *stream = map->stream;
+    stream->states[idx] = MAP_STREAM_LOADED;
+
+    Uint32 x = (idx % map->chunks_w) * MAP_CHUNK_SIZE;
+    Uint32 y = (idx / map->chunks_w) * MAP_CHUNK_SIZE;
+    Uint32 w = SDL_min(MAP_CHUNK_SIZE, map->w - x);
+    Uint32 h = SDL_min(MAP_CHUNK_SIZE, map->h - y);
+
+    Uint32 encoding =
+        map_read_u32(stream->index + (size_t)idx * MAP_V2_CHUNK_SIZE + 8);
+    if (!map_decode_chunk(map, x, y, w, h, encoding, data, size))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Invalid chunk %u in map %s", idx, map->name);
+    }
+
+    // The chunk, and the edges of the chunks around it that face it.
+    map_autotile_region(map, (Sint64)x - 1, (Sint64)y - 1, x + w + 1,
+                        y + h + 1);
+    map_notify(map, (Sint64)x - 1, (Sint64)y - 1, x + w + 1, y + h + 1);
+}
+
+/**
+ * Decodes the chunks whose reads finished.
+ */
+void map_stream_collect(Map *map)
+{
+    MapStream *stream = map->stream;
+    if (!stream->queue)
+        return;
+
+    SDL_AsyncIOOutcome outcome;
+    while (SDL_GetAsyncIOResult(stream->queue, &outcome))
+    {
+        Uint32 idx = (Uint32)(uintptr_t)outcome.userdata;
+        stream->num_loading--;
+
+        if (outcome.result == SDL_ASYNCIO_COMPLETE &&
+            outcome.bytes_transferred == outcome.bytes_requested)
+        {
+            map_stream_place(map, idx, outcome.buffer,
+                             (Uint32)outcome.bytes_transferred);
+        }
+        else
+        {
+            // Don't retry every frame, the chunk stays air.
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Unable to read chunk %u of map %s", idx, map->name);
+            stream->states[idx] = MAP_STREAM_LOADED;
+        }
+        SDL_free(outcome.buffer);
+    }
+}
+
+/**
+ * Marks a chunk as wanted for this update, and starts loading it if it's not
+ * in memory.
+ */
+void map_stream_want(Map *map, Uint32 idx)
+{
+    MapStream *stream = map->stream;
+    MapChunk *chunk =
+        map_get_chunk(map, idx % map->chunks_w, idx / map->chunks_w);
+    if (chunk)
+    {
+        chunk->last_used = stream->updates;
+        return;
+    }
+    if (stream->states[idx] != MAP_STREAM_UNLOADED)
+        return;
+
+    const Uint8 *entry = stream->index + (size_t)idx * MAP_V2_CHUNK_SIZE;
+    Uint32 at = map_read_u32(entry);
+    Uint32 len = map_read_u32(entry + 4);
+    if (stream->data)
+    {
+        map_stream_place(map, idx, stream->data + at, len);
+        return;
+    }
+
+    void *buf = SDL_malloc(len);
+    if (!SDL_ReadAsyncIO(stream->file, buf, at, len, stream->queue,
+                         (void *)(uintptr_t)idx))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to read chunk %u of map %s. %s", idx, map->name,
+                     SDL_GetError());
+        SDL_free(buf);
+        return;
+    }
+
+    stream->states[idx] = MAP_STREAM_LOADING;
+    stream->num_loading++;
+}
+
+/**
+ * Unloads the chunks that were wanted the longest time ago, until the stream
+ * is within its budget. Chunks wanted by this update are always kept.
+ */
+void map_stream_evict(Map *map)
+{
+    MapStream *stream = map->stream;
+    while (map->num_chunks > MAP_STREAM_BUDGET)
+    {
+        MapChunk *oldest = NULL;
+        for (Uint32 i = 0; i < map->num_chunks; i++)
+        {
+            MapChunk *chunk = map->chunk_list[i];
+            if (chunk->last_used < stream->updates &&
+                (!oldest || chunk->last_used < oldest->last_used))
+                oldest = chunk;
+        }
+        if (!oldest)
+            break;
+
+        // Chunks of air in the file, that were edited, are air again and have
+        // nothing to load back.
+        Sint64 x = (Sint64)oldest->cx * MAP_CHUNK_SIZE;
+        Sint64 y = (Sint64)oldest->cy * MAP_CHUNK_SIZE;
+        Uint32 idx = oldest->cy * map->chunks_w + oldest->cx;
+        const Uint8 *entry = stream->index + (size_t)idx * MAP_V2_CHUNK_SIZE;
+        stream->states[idx] = map_read_u32(entry + 8) == MAP_CHUNK_EMPTY
+                                  ? MAP_STREAM_LOADED
+                                  : MAP_STREAM_UNLOADED;
+        map_chunk_free(map, oldest);
+
+        // The chunks around it lost a neighbor.
+        map_autotile_region(map, x - 1, y - 1, x + MAP_CHUNK_SIZE + 1,
+                            y + MAP_CHUNK_SIZE + 1);
+        map_notify(map, x - 1, y - 1, x + MAP_CHUNK_SIZE + 1,
+                   y + MAP_CHUNK_SIZE + 1);
+    }
+}
+
+void map_stream_update(Map *map, double x, double y)
+{
+    MapStream *stream = map ? map->stream : NULL;
+    if (!stream)
+        return;
+
+    stream->updates++;
+    map_stream_collect(map);
+
+    // Where the focus is heading, from where it was at the last update.
+    int dir_x = (x > stream->last_x) - (x < stream->last_x);
+    int dir_y = (y > stream->last_y) - (y < stream->last_y);
+    stream->last_x = x;
+    stream->last_y = y;
+
+    // The square around the focus, stretched ahead in the direction of
+    // travel, and clamped to the map.
+    Sint64 fx = (Sint64)SDL_floor(x / MAP_CHUNK_SIZE);
+    Sint64 fy = (Sint64)SDL_floor(y / MAP_CHUNK_SIZE);
+    Sint64 x0 = fx - MAP_STREAM_RADIUS - (dir_x < 0 ? MAP_STREAM_LOOKAHEAD : 0);
+    Sint64 x1 = fx + MAP_STREAM_RADIUS + (dir_x > 0 ? MAP_STREAM_LOOKAHEAD : 0);
+    Sint64 y0 = fy - MAP_STREAM_RADIUS - (dir_y < 0 ? MAP_STREAM_LOOKAHEAD : 0);
+    Sint64 y1 = fy + MAP_STREAM_RADIUS + (dir_y > 0 ? MAP_STREAM_LOOKAHEAD : 0);
+    x0 = SDL_max(x0, 0);
+    y0 = SDL_max(y0, 0);
+    x1 = SDL_min(x1, (Sint64)map->chunks_w - 1);
+    y1 = SDL_min(y1, (Sint64)map->chunks_h - 1);
+
+    // Ring by ring from the focus, so the closest chunks are read first.
+    for (Sint64 d = 0; d <= MAP_STREAM_RADIUS + MAP_STREAM_LOOKAHEAD; d++)
+    {
+        for (Sint64 cy = SDL_max(y0, fy - d); cy <= SDL_min(y1, fy + d); cy++)
+        {
+            for (Sint64 cx = SDL_max(x0, fx - d); cx <= SDL_min(x1, fx + d);
+                 cx++)
+            {
+                Sint64 dx = cx > fx ? cx - fx : fx - cx;
+                Sint64 dy = cy > fy ? cy - fy : fy - cy;
+                if (SDL_max(dx, dy) == d)
+                    map_stream_want(map, (Uint32)(cy * map->chunks_w + cx));
+            }
+        }
+    }
+
+    map_stream_evict(map);
+}
+
+/**
+ * Closes a map's stream. Reads in progress write into their buffers, so they
+ * are waited for.
+ */
+void map_stream_close(MapStream *stream)
+{
+    SDL_AsyncIOOutcome outcome;
+    while (stream->num_loading > 0 &&
+           SDL_WaitAsyncIOResult(stream->queue, &outcome, -1))
+    {
+        SDL_free(outcome.buffer);
+        stream->num_loading--;
+    }
+
+    if (stream->file &&
+        SDL_CloseAsyncIO(stream->file, false, stream->queue, NULL))
+        SDL_WaitAsyncIOResult(stream->queue, &outcome, -1);
+    if (stream->queue)
+        SDL_DestroyAsyncIOQueue(stream->queue);
+
+    SDL_free(stream->index);
+    SDL_free(stream->states);
+    SDL_free(stream);
+}
+
+int map_tile_tag(const SpriteSheet *sheet, MapTile tile)
 {
     switch (tile)
     {
-    case TILE_AIR:
-        sprite_set_animation(spr, NULL);
-        break;
     case TILE_WOOD:
-        sprite_set_animation(spr, "wood");
-        break;
+        return sprite_sheet_find_tag(sheet, "wood");
+    default:
+        return -1;
     }
 }
 
@@ -145,7 +1123,15 @@ void map_destroy(Map *map)
     if (!map)
         return;
 
+    if (map->stream)
+        map_stream_close(map->stream);
+
+    for (Uint32 i = 0; i < map->num_chunks; i++)
+        SDL_free(map->chunk_list[i]);
+
     SDL_free(map->name);
-    SDL_free(map->tiles);
+    hash_map_destroy(map->chunks);
+    SDL_free(map->chunk_list);
+    SDL_free(map->listeners);
     SDL_free(map);
 }
@@ -0,0 +1,119 @@
+#include "engine/pacing.h"
+#include "SDL3/SDL_error.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_render.h"
+#include "SDL3/SDL_stdinc.h"
+#include "SDL3/SDL_timer.h"
+
+// The amount of time to busy-wait at first, before we know how bad the OS
+// sleeps are.
+#define FRAME_PACER_DEFAULT_SPIN_NS (1 * SDL_NS_PER_MS)
+
+// We never spin for longer than this, even if the OS oversleeps a lot.
+#define FRAME_PACER_MAX_SPIN_NS (4 * SDL_NS_PER_MS)
+
+void frame_pacer_init(FramePacer *pacer, Uint32 fps)
+{
+    pacer->next_frame_ns = 0;
+    pacer->spin_ns = FRAME_PACER_DEFAULT_SPIN_NS;
+    pacer->vsync = VSYNC_MODE_OFF;
+    frame_pacer_set_target_fps(pacer, fps);
+}
+
+void frame_pacer_set_target_fps(FramePacer *pacer, Uint32 fps)
+{
+    pacer->frame_ns = fps == 0 ? 0 : SDL_NS_PER_SECOND / fps;
+
+    // Start counting from the next wait, so the new rate applies right away.
+    pacer->next_frame_ns = 0;
+}
+
+bool frame_pacer_set_vsync(FramePacer *pacer, SDL_Renderer *renderer,
+                           VsyncMode mode)
+{
+    // Try the requested mode first, then fall back to less strict ones.
+    if (mode == VSYNC_MODE_ADAPTIVE)
+    {
+        if (SDL_SetRenderVSync(renderer, SDL_RENDERER_VSYNC_ADAPTIVE))
+        {
+            pacer->vsync = VSYNC_MODE_ADAPTIVE;
+            return true;
+        }
+
+        SDL_LogWarn(SDL_LOG_CATEGORY_RENDER,
+                    "Adaptive vsync is not supported, using vsync. %s",
+                    SDL_GetError());
+        mode = VSYNC_MODE_ON;
+    }
+
+    if (mode == VSYNC_MODE_ON)
+    {
+        if (SDL_SetRenderVSync(renderer, 1))
+        {
+            pacer->vsync = VSYNC_MODE_ON;
+            return true;
+        }
+
+        SDL_LogWarn(SDL_LOG_CATEGORY_RENDER,
+                    "Vsync is not supported, using the frame limiter only. %s",
+                    SDL_GetError());
+    }
+
+    pacer->vsync = VSYNC_MODE_OFF;
+    return SDL_SetRenderVSync(renderer, SDL_RENDERER_VSYNC_DISABLED);
+}
+
+void frame_pacer_wait(FramePacer *pacer)
+{
+    if (pacer->frame_ns == 0)
+        return;
+
+    Uint64 now = SDL_GetTicksNS();
+
+    // First frame, or the rate just changed. Nothing to wait for yet.
+    if (pacer->next_frame_ns == 0)
+    {
+        pacer->next_frame_ns = now + pacer->frame_ns;
+        return;
+    }
+
+    Uint64 deadline = pacer->next_frame_ns;
+    if (now < deadline)
+    {
+        // Sleep through most of the interval. The OS usually wakes us up a bit
+        // late, so we leave `spin_ns` to busy-wait at the end.
+        Uint64 remaining = deadline - now;
+        if (remaining > pacer->spin_ns)
+        {
+            Uint64 sleep = remaining - pacer->spin_ns;
+            SDL_DelayNS(sleep);
+
+            // Learn how late the sleeps wake up. If it overslept past the
+            // spinning window, spin longer next time. Otherwise, slowly give
+            // some of that time back to sleeping.
+            Uint64 slept = SDL_GetTicksNS() - now;
+            Uint64 overshoot = slept > sleep ? slept - sleep : 0;
+            if (overshoot > pacer->spin_ns)
+            {
+                pacer->spin_ns =
+                    SDL_min(overshoot + overshoot / 4, FRAME_PACER_MAX_SPIN_NS);
+            }
+            else if (pacer->spin_ns > FRAME_PACER_DEFAULT_SPIN_NS)
+            {
+                pacer->spin_ns -= pacer->spin_ns / 64;
+            }
+        }
+
+        // Spin for the last fraction.
+        while ((now = SDL_GetTicksNS()) < deadline)
+        {
+        }
+    }
+
+    // Schedule the next frame from the deadline, not from now, so small
+    // wake-up errors don't add up. If we're late by more than a frame, we give
+    // up catching up and restart from now, otherwise frames would burst.
+    pacer->next_frame_ns = deadline + pacer->frame_ns;
+    if (now >= pacer->next_frame_ns)
+        pacer->next_frame_ns = now + pacer->frame_ns;
+}
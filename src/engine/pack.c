@@ -0,0 +1,255 @@
+#include "engine/pack.h"
+#include "SDL3/SDL_iostream.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_stdinc.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define PACK_MAGIC "SAKP"
+#define PACK_VERSION 1
+
+// The fixed sizes of the header and of a table of contents entry, in bytes.
+#define PACK_HEADER_SIZE 16
+#define PACK_ENTRY_SIZE 24
+
+/**
+ * Represents the opened pack file.
+ */
+typedef struct
+{
+    const Uint8 *data; // The whole file.
+    size_t size;
+    Uint32 num_entries;
+    const Uint8 *toc;   // The table of contents, sorted by path.
+    const Uint8 *names; // The paths the table of contents points into.
+    bool mapped;        // Whether `data` is mapped, or read into memory.
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} Pack;
+
+static Pack pack = {0};
+
+/**
+ * Reads a little endian u32 from the pack.
+ */
+Uint32 pack_read_u32(const Uint8 *data)
+{
+    Uint32 value;
+    SDL_memcpy(&value, data, sizeof(value));
+    return SDL_Swap32LE(value);
+}
+
+/**
+ * Reads a little endian u64 from the pack.
+ */
+Uint64 pack_read_u64(const Uint8 *data)
+{
+    Uint64 value;
+    SDL_memcpy(&value, data, sizeof(value));
+    return SDL_Swap64LE(value);
+}
+
+/**
+ * Maps a whole file into memory, read-only.
+ */
+bool pack_map(const char *path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    const void *view = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping)
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (!view)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    pack.file = file;
+    pack.mapping = mapping;
+    pack.data = view;
+    pack.size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    void *view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping stays valid after the file is closed.
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    pack.data = view;
+    pack.size = (size_t)st.st_size;
+#endif
+
+    pack.mapped = true;
+    return true;
+}
+
+/**
+ * Checks that the header and the table of contents fit in the file.
+ */
+bool pack_validate(void)
+{
+    if (pack.size < PACK_HEADER_SIZE ||
+        SDL_memcmp(pack.data, PACK_MAGIC, 4) != 0)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Not an asset pack");
+        return false;
+    }
+
+    Uint32 version = pack_read_u32(pack.data + 4);
+    if (version != PACK_VERSION)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unknown asset pack version %u", version);
+        return false;
+    }
+
+    pack.num_entries = pack_read_u32(pack.data + 8);
+    Uint64 names_at = pack_read_u32(pack.data + 12);
+    Uint64 toc_end =
+        PACK_HEADER_SIZE + (Uint64)pack.num_entries * PACK_ENTRY_SIZE;
+    if (toc_end > pack.size || names_at > pack.size || names_at < toc_end)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Asset pack table of contents is cut off");
+        return false;
+    }
+
+    pack.toc = pack.data + PACK_HEADER_SIZE;
+    pack.names = pack.data + names_at;
+    return true;
+}
+
+bool pack_open(const char *path)
+{
+    pack_close();
+
+    if (!pack_map(path))
+    {
+        // No mapping, read it all instead.
+        pack.data = SDL_LoadFile(path, &pack.size);
+        if (!pack.data)
+            return false;
+    }
+
+    if (!pack_validate())
+    {
+        pack_close();
+        return false;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Opened asset pack with %u files", pack.num_entries);
+    return true;
+}
+
+const void *pack_get(const char *path, size_t *size)
+{
+    if (!pack.data)
+        return NULL;
+
+    // Binary search, the table of contents is sorted by path.
+    size_t len = SDL_strlen(path);
+    Uint32 lo = 0, hi = pack.num_entries;
+    while (lo < hi)
+    {
+        Uint32 mid = lo + (hi - lo) / 2;
+        const Uint8 *entry = pack.toc + (size_t)mid * PACK_ENTRY_SIZE;
+        Uint64 name_at = pack_read_u32(entry);
+        Uint32 name_len = pack_read_u32(entry + 4);
+
+        const Uint8 *name = pack.names + name_at;
+        if (name + name_len > pack.data + pack.size)
+            return NULL;
+
+        int cmp = SDL_memcmp(name, path, SDL_min(name_len, len));
+        if (cmp == 0)
+            cmp = name_len < len ? -1 : (name_len > len ? 1 : 0);
+
+        if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else if (cmp > 0)
+        {
+            hi = mid;
+        }
+        else
+        {
+            Uint64 data_at = pack_read_u64(entry + 8);
+            Uint64 data_size = pack_read_u64(entry + 16);
+            if (data_at > pack.size || data_size > pack.size - data_at)
+                return NULL;
+
+            *size = (size_t)data_size;
+            return pack.data + data_at;
+        }
+    }
+
+    return NULL;
+}
+
+void *pack_read(const char *path, size_t *size, bool *owned)
+{
+    const void *data = pack_get(path, size);
+    if (data)
+    {
+        *owned = false;
+        return (void *)data;
+    }
+
+    *owned = true;
+    return SDL_LoadFile(path, size);
+}
+
+void pack_close(void)
+{
+    if (!pack.data)
+        return;
+
+    if (!pack.mapped)
+    {
+        SDL_free((void *)pack.data);
+    }
+    else
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(pack.data);
+        CloseHandle(pack.mapping);
+        CloseHandle(pack.file);
+#else
+        munmap((void *)pack.data, pack.size);
+#endif
+    }
+
+    pack = (Pack){0};
+}
@@ -0,0 +1,1262 @@
+#include "engine/path.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_stdinc.h"
+#include "SDL3/SDL_timer.h"
+#include "misc/array.h"
+
+// The node table holds every tile a search reached. Its size is a power of 2,
+// and searches give up once it's 3/4 full.
+#define PATH_NODE_BITS 15
+#define PATH_MAX_NODES (1 << PATH_NODE_BITS)
+#define PATH_NODE_LIMIT (PATH_MAX_NODES / 4 * 3)
+
+// The heap position of nodes that are not, or no longer, in the open heap.
+#define PATH_NONE SDL_MAX_UINT32
+#define PATH_CLOSED (SDL_MAX_UINT32 - 1)
+
+// The keys of the start and the goal, in the cluster graph.
+#define PATH_KEY_START (SDL_MAX_UINT32 - 1)
+#define PATH_KEY_GOAL (SDL_MAX_UINT32 - 2)
+
+// How many entrances a cluster has at most on one side. Open runs at least
+// PATH_LONG_RUN long get an entrance at both ends, others one in the middle.
+#define PATH_MAX_SIDE_ENTRANCES 16
+#define PATH_MAX_ENTRANCES (4 * PATH_MAX_SIDE_ENTRANCES)
+#define PATH_LONG_RUN 6
+#define PATH_UNREACHABLE SDL_MAX_UINT16
+
+// Floods stay inside of a cluster. Every tile is pushed at most once for each
+// of its 8 neighbors, plus the start.
+#define PATH_FLOOD_TILES (MAP_CHUNK_SIZE * MAP_CHUNK_SIZE)
+#define PATH_FLOOD_HEAP (8 * PATH_FLOOD_TILES + 1)
+
+// The costs between entrances fit in 16 bits, so a flood's cost and tile fit
+// together in 32.
+SDL_COMPILE_TIME_ASSERT(path_cluster_cost,
+                        MAP_CHUNK_SIZE * MAP_CHUNK_SIZE * PATH_COST_DIAGONAL <
+                            PATH_UNREACHABLE);
+SDL_COMPILE_TIME_ASSERT(path_flood_tiles, PATH_FLOOD_TILES <= 1 << 16);
+
+/**
+ * Represents a side of a cluster. Opposite sides only differ by the low bit.
+ */
+typedef enum
+{
+    PATH_SIDE_N,
+    PATH_SIDE_S,
+    PATH_SIDE_W,
+    PATH_SIDE_E,
+} PathSide;
+
+/**
+ * Represents a tile, or a cluster entrance, reached by a search.
+ */
+typedef struct
+{
+    Uint32 key;    // The tile's index, or the entrance's key.
+    Uint32 search; // The search that reached it. Nodes of older ones are free.
+    Uint32 g;      // The cost from the start.
+    Uint32 f;      // The cost from the start, plus the estimate to the goal.
+    Uint32 parent; // The node it was reached from, or PATH_NONE.
+    Uint32 heap;   // Where it is in the open heap, PATH_NONE or PATH_CLOSED.
+} PathNode;
+
+/**
+ * Represents the rectangle a search stays in, from (x0, y0) up to (x1, y1)
+ * excluded.
+ */
+typedef struct
+{
+    int x0, y0;
+    int x1, y1;
+} PathBox;
+
+/**
+ * Represents one of the map's chunks in the cluster graph. Its entrances are
+ * open tiles on its edges, with an open tile right across in the next
+ * cluster. Both clusters find the same entrances on the edge they share, in
+ * the same order.
+ */
+typedef struct
+{
+    Uint16 entrances[PATH_MAX_ENTRANCES]; // Tiles, from the cluster's corner.
+    Uint8 first[5]; // Where each side's entrances start, then the count.
+    Uint16 *dist;   // The cost between every 2 entrances, inside the cluster.
+    bool dirty;     // Whether tiles changed since it was built.
+} PathCluster;
+
+/**
+ * Represents a path kept for later searches between the same tiles.
+ */
+typedef struct
+{
+    SDL_Point start;
+    SDL_Point goal;
+    Path path;
+    bool found;
+    PathBox bounds;   // The tiles that affect the path.
+    Uint64 last_used; // 0 if the entry is free.
+} PathCacheEntry;
+
+struct Pathfinder
+{
+    Map *map;
+    Uint64 *solid; // A bit per tile, set if the tile is solid.
+    Uint32 stride; // How many words a row of `solid` takes.
+
+    // The search buffers, reused by every search.
+    PathNode *nodes;
+    Uint32 num_nodes;
+    Uint32 search;
+    bool exhausted; // Whether the last search ran out of nodes.
+    Uint32 *heap;   // The open nodes, by their index in `nodes`.
+    Uint32 heap_len;
+    SDL_Point start, goal;
+
+    PathCluster *clusters; // NULL without the cluster graph.
+    Uint32 num_clusters;
+    Path route; // The entrances a route goes through, before it's refined.
+
+    // The flood buffers, apart from the search's, so clusters can be built
+    // while a route is searched.
+    PathBox flood_box;
+    Uint32 *flood_cost; // The cost of every tile of the box, or PATH_NONE.
+    Uint32 *flood_heap; // The tiles to visit, as their cost, then their index.
+
+    PathCacheEntry cache[PATH_CACHE_SIZE];
+    Uint64 uses;
+
+    ARRAY(PathRequest *) queue; // The submitted requests, oldest first.
+};
+
+/**
+ * Checks if a tile is inside of the box, and not solid.
+ */
+bool path_open(const Pathfinder *pf, const PathBox *box, int x, int y)
+{
+    if (x < box->x0 || y < box->y0 || x >= box->x1 || y >= box->y1)
+        return false;
+
+    Uint64 word = pf->solid[(size_t)y * pf->stride + (Uint32)x / 64];
+    return !((word >> (x % 64)) & 1);
+}
+
+/**
+ * Marks a tile as solid or not. Returns true if it changed.
+ */
+bool path_set_solid(Pathfinder *pf, Uint32 x, Uint32 y, bool solid)
+{
+    Uint64 *word = &pf->solid[(size_t)y * pf->stride + x / 64];
+    Uint64 bit = (Uint64)1 << (x % 64);
+    if (((*word & bit) != 0) == solid)
+        return false;
+
+    *word ^= bit;
+    return true;
+}
+
+/**
+ * Retrieves the cost of the shortest move by (dx, dy) on an open grid.
+ */
+Uint32 path_octile(int dx, int dy)
+{
+    Uint32 ax = (Uint32)(dx < 0 ? -dx : dx);
+    Uint32 ay = (Uint32)(dy < 0 ? -dy : dy);
+    Uint32 lo = SDL_min(ax, ay), hi = SDL_max(ax, ay);
+    return PATH_COST_DIAGONAL * lo + PATH_COST_STRAIGHT * (hi - lo);
+}
+
+/**
+ * Retrieves the box of the whole map.
+ */
+PathBox path_map_box(const Pathfinder *pf)
+{
+    return (PathBox){0, 0, (int)pf->map->w, (int)pf->map->h};
+}
+
+/**
+ * Retrieves the box of a cluster. Clusters on the map's far edges are cut.
+ */
+PathBox path_cluster_box(const Pathfinder *pf, Uint32 index)
+{
+    int x = (int)(index % pf->map->chunks_w) * MAP_CHUNK_SIZE;
+    int y = (int)(index / pf->map->chunks_w) * MAP_CHUNK_SIZE;
+    return (PathBox){
+        x,
+        y,
+        SDL_min(x + MAP_CHUNK_SIZE, (int)pf->map->w),
+        SDL_min(y + MAP_CHUNK_SIZE, (int)pf->map->h),
+    };
+}
+
+/**
+ * Retrieves the cluster a tile is in.
+ */
+Uint32 path_cluster_of(const Pathfinder *pf, SDL_Point p)
+{
+    return (Uint32)(p.y / MAP_CHUNK_SIZE) * pf->map->chunks_w +
+           (Uint32)(p.x / MAP_CHUNK_SIZE);
+}
+
+/**
+ * Retrieves the tile of a cluster's entrance.
+ */
+SDL_Point path_entrance(const Pathfinder *pf, Uint32 index, Uint32 i)
+{
+    PathBox box = path_cluster_box(pf, index);
+    Uint16 tile = pf->clusters[index].entrances[i];
+    return (SDL_Point){box.x0 + tile % MAP_CHUNK_SIZE,
+                       box.y0 + tile / MAP_CHUNK_SIZE};
+}
+
+/**
+ * Makes sure a path can hold `length` points.
+ */
+void path_reserve(Path *path, Uint32 length)
+{
+    if (length <= path->capacity)
+        return;
+
+    path->capacity = SDL_max(SDL_max(length, path->capacity * 2), 16);
+    path->points =
+        SDL_realloc(path->points, path->capacity * sizeof(SDL_Point));
+}
+
+/**
+ * Copies the points and cost of a path into another.
+ */
+void path_copy(Path *dst, const Path *src)
+{
+    path_reserve(dst, src->length);
+    if (src->length > 0)
+        SDL_memcpy(dst->points, src->points,
+                   src->length * sizeof(SDL_Point));
+    dst->length = src->length;
+    dst->cost = src->cost;
+}
+
+/**
+ * Starts a new search. The nodes of the previous one are left where they are,
+ * and are only told apart by their search number.
+ */
+void path_begin(Pathfinder *pf)
+{
+    if (++pf->search == 0)
+    {
+        SDL_memset(pf->nodes, 0, PATH_MAX_NODES * sizeof(PathNode));
+        pf->search = 1;
+    }
+
+    pf->num_nodes = 0;
+    pf->heap_len = 0;
+    pf->exhausted = false;
+}
+
+/**
+ * Finds the node of a key in this search. With `create`, a missing node is
+ * added, unless the table is full.
+ */
+PathNode *path_node(Pathfinder *pf, Uint32 key, bool create)
+{
+    Uint32 slot = (key * 2654435761u) >> (32 - PATH_NODE_BITS);
+    for (;;)
+    {
+        PathNode *node = &pf->nodes[slot];
+        if (node->search != pf->search)
+        {
+            if (!create)
+                return NULL;
+            if (pf->num_nodes >= PATH_NODE_LIMIT)
+            {
+                pf->exhausted = true;
+                return NULL;
+            }
+
+            pf->num_nodes++;
+            *node = (PathNode){
+                .key = key,
+                .search = pf->search,
+                .g = SDL_MAX_UINT32,
+                .parent = PATH_NONE,
+                .heap = PATH_NONE,
+            };
+            return node;
+        }
+        if (node->key == key)
+            return node;
+
+        slot = (slot + 1) & (PATH_MAX_NODES - 1);
+    }
+}
+
+/**
+ * Checks if a node should be searched before another. Ties go to the node
+ * closest to the goal.
+ */
+bool path_heap_less(const Pathfinder *pf, Uint32 a, Uint32 b)
+{
+    const PathNode *na = &pf->nodes[a], *nb = &pf->nodes[b];
+    return na->f < nb->f || (na->f == nb->f && na->g > nb->g);
+}
+
+/**
+ * Moves a node of the open heap up, until its parent comes first.
+ */
+void path_heap_up(Pathfinder *pf, Uint32 pos)
+{
+    Uint32 slot = pf->heap[pos];
+    while (pos > 0)
+    {
+        Uint32 parent = (pos - 1) / 2;
+        if (!path_heap_less(pf, slot, pf->heap[parent]))
+            break;
+
+        pf->heap[pos] = pf->heap[parent];
+        pf->nodes[pf->heap[pos]].heap = pos;
+        pos = parent;
+    }
+
+    pf->heap[pos] = slot;
+    pf->nodes[slot].heap = pos;
+}
+
+/**
+ * Moves a node of the open heap down, until it comes before its children.
+ */
+void path_heap_down(Pathfinder *pf, Uint32 pos)
+{
+    Uint32 slot = pf->heap[pos];
+    for (;;)
+    {
+        Uint32 child = pos * 2 + 1;
+        if (child >= pf->heap_len)
+            break;
+        if (child + 1 < pf->heap_len &&
+            path_heap_less(pf, pf->heap[child + 1], pf->heap[child]))
+            child++;
+        if (!path_heap_less(pf, pf->heap[child], slot))
+            break;
+
+        pf->heap[pos] = pf->heap[child];
+        pf->nodes[pf->heap[pos]].heap = pos;
+        pos = child;
+    }
+
+    pf->heap[pos] = slot;
+    pf->nodes[slot].heap = pos;
+}
+
+/**
+ * Takes the open node that comes first out of the heap, and closes it.
+ */
+Uint32 path_pop(Pathfinder *pf)
+{
+    Uint32 slot = pf->heap[0];
+    pf->nodes[slot].heap = PATH_CLOSED;
+
+    if (--pf->heap_len > 0)
+    {
+        pf->heap[0] = pf->heap[pf->heap_len];
+        path_heap_down(pf, 0);
+    }
+    return slot;
+}
+
+/**
+ * Reaches a node from another with the cost `g`, if that's cheaper than how
+ * it was reached before. `h` is the estimate from the node to the goal.
+ */
+void path_relax(Pathfinder *pf, Uint32 from, Uint32 key, Uint32 g, Uint32 h)
+{
+    PathNode *node = path_node(pf, key, true);
+    if (!node || node->heap == PATH_CLOSED || g >= node->g)
+        return;
+
+    node->g = g;
+    node->f = g + h;
+    node->parent = from;
+    if (node->heap == PATH_NONE)
+    {
+        node->heap = pf->heap_len++;
+        pf->heap[node->heap] = (Uint32)(node - pf->nodes);
+    }
+    path_heap_up(pf, node->heap);
+}
+
+/**
+ * Starts a search from a key.
+ */
+void path_push_root(Pathfinder *pf, Uint32 key, Uint32 h)
+{
+    path_relax(pf, PATH_NONE, key, 0, h);
+}
+
+/**
+ * Retrieves the tile of a node's key, in a search over tiles.
+ */
+SDL_Point path_tile_point(const Pathfinder *pf, Uint32 key)
+{
+    return (SDL_Point){(int)(key % pf->map->w), (int)(key / pf->map->w)};
+}
+
+/**
+ * Retrieves the tile of a node's key, in a search over the cluster graph.
+ */
+SDL_Point path_route_point(const Pathfinder *pf, Uint32 key)
+{
+    if (key == PATH_KEY_START)
+        return pf->start;
+    if (key == PATH_KEY_GOAL)
+        return pf->goal;
+    return path_entrance(pf, key / PATH_MAX_ENTRANCES,
+                         key % PATH_MAX_ENTRANCES);
+}
+
+/**
+ * Writes the nodes from the search's root to a node into a path. With
+ * `append`, the root is left out, as it's already the path's last point.
+ */
+void path_reconstruct(Pathfinder *pf, Uint32 slot, Path *path, bool append,
+                      SDL_Point (*to_point)(const Pathfinder *, Uint32))
+{
+    Uint32 count = 0;
+    for (Uint32 at = slot; at != PATH_NONE; at = pf->nodes[at].parent)
+        count++;
+    if (append)
+        count--;
+
+    Uint32 start = append ? path->length : 0;
+    path_reserve(path, start + count);
+    path->length = start + count;
+
+    Uint32 i = path->length;
+    for (Uint32 at = slot; i > start; at = pf->nodes[at].parent)
+        path->points[--i] = to_point(pf, pf->nodes[at].key);
+}
+
+/**
+ * Jumps from (x, y) in a straight line, until a tile where the path may turn.
+ * Returns false if it ran into a solid tile first.
+ */
+bool path_jump_straight(const Pathfinder *pf, const PathBox *box, int *x,
+                        int *y, int dx, int dy)
+{
+    int cx = *x, cy = *y;
+    for (;;)
+    {
+        cx += dx;
+        cy += dy;
+        if (!path_open(pf, box, cx, cy))
+            return false;
+        if (cx == pf->goal.x && cy == pf->goal.y)
+            break;
+
+        // A wall just ended beside the line.
+        if (dx != 0 &&
+            ((path_open(pf, box, cx, cy - 1) &&
+              !path_open(pf, box, cx - dx, cy - 1)) ||
+             (path_open(pf, box, cx, cy + 1) &&
+              !path_open(pf, box, cx - dx, cy + 1))))
+            break;
+        if (dy != 0 &&
+            ((path_open(pf, box, cx - 1, cy) &&
+              !path_open(pf, box, cx - 1, cy - dy)) ||
+             (path_open(pf, box, cx + 1, cy) &&
+              !path_open(pf, box, cx + 1, cy - dy))))
+            break;
+    }
+
+    *x = cx;
+    *y = cy;
+    return true;
+}
+
+/**
+ * Jumps from (x, y) diagonally, until a straight jump from the line finds
+ * somewhere to turn. Returns false if it ran into a solid tile first.
+ */
+bool path_jump_diagonal(const Pathfinder *pf, const PathBox *box, int *x,
+                        int *y, int dx, int dy)
+{
+    int cx = *x, cy = *y;
+    for (;;)
+    {
+        cx += dx;
+        cy += dy;
+        if (!path_open(pf, box, cx, cy))
+            return false;
+        if (cx == pf->goal.x && cy == pf->goal.y)
+            break;
+
+        int sx = cx, sy = cy;
+        if (path_jump_straight(pf, box, &sx, &sy, dx, 0))
+            break;
+        sx = cx;
+        sy = cy;
+        if (path_jump_straight(pf, box, &sx, &sy, 0, dy))
+            break;
+
+        // No cutting corners.
+        if (!path_open(pf, box, cx + dx, cy) ||
+            !path_open(pf, box, cx, cy + dy))
+            return false;
+    }
+
+    *x = cx;
+    *y = cy;
+    return true;
+}
+
+/**
+ * Finds the directions worth jumping in from a node, given where it was
+ * reached from. Returns how many were written into `dirs`.
+ */
+int path_prune(const Pathfinder *pf, const PathBox *box, const PathNode *node,
+               int x, int y, int dirs[8][2])
+{
+    int n = 0;
+    if (node->parent == PATH_NONE)
+    {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if ((dx == 0 && dy == 0) ||
+                    (dx != 0 && dy != 0 &&
+                     (!path_open(pf, box, x + dx, y) ||
+                      !path_open(pf, box, x, y + dy))))
+                    continue;
+
+                dirs[n][0] = dx;
+                dirs[n++][1] = dy;
+            }
+        }
+        return n;
+    }
+
+    SDL_Point from = path_tile_point(pf, pf->nodes[node->parent].key);
+    int dx = SDL_clamp(x - from.x, -1, 1);
+    int dy = SDL_clamp(y - from.y, -1, 1);
+
+#define PATH_ADD_DIR(ddx, ddy)                                                 \
+    do                                                                         \
+    {                                                                          \
+        dirs[n][0] = (ddx);                                                    \
+        dirs[n++][1] = (ddy);                                                  \
+    } while (0)
+
+    if (dx != 0 && dy != 0)
+    {
+        bool vertical = path_open(pf, box, x, y + dy);
+        bool horizontal = path_open(pf, box, x + dx, y);
+        if (vertical)
+            PATH_ADD_DIR(0, dy);
+        if (horizontal)
+            PATH_ADD_DIR(dx, 0);
+        if (vertical && horizontal)
+            PATH_ADD_DIR(dx, dy);
+    }
+    else if (dx != 0)
+    {
+        bool next = path_open(pf, box, x + dx, y);
+        bool up = path_open(pf, box, x, y - 1);
+        bool down = path_open(pf, box, x, y + 1);
+        if (next)
+        {
+            PATH_ADD_DIR(dx, 0);
+            if (up)
+                PATH_ADD_DIR(dx, -1);
+            if (down)
+                PATH_ADD_DIR(dx, 1);
+        }
+        if (up)
+            PATH_ADD_DIR(0, -1);
+        if (down)
+            PATH_ADD_DIR(0, 1);
+    }
+    else
+    {
+        bool next = path_open(pf, box, x, y + dy);
+        bool left = path_open(pf, box, x - 1, y);
+        bool right = path_open(pf, box, x + 1, y);
+        if (next)
+        {
+            PATH_ADD_DIR(0, dy);
+            if (left)
+                PATH_ADD_DIR(-1, dy);
+            if (right)
+                PATH_ADD_DIR(1, dy);
+        }
+        if (left)
+            PATH_ADD_DIR(-1, 0);
+        if (right)
+            PATH_ADD_DIR(1, 0);
+    }
+
+#undef PATH_ADD_DIR
+    return n;
+}
+
+/**
+ * Finds the shortest path between 2 open tiles with jump point search,
+ * without leaving the box. With `append`, the points are added after the
+ * path's last point, which must be the start.
+ */
+bool path_search_jps(Pathfinder *pf, const PathBox *box, SDL_Point start,
+                     SDL_Point goal, Path *path, bool append)
+{
+    Uint32 w = pf->map->w;
+    path_begin(pf);
+    pf->goal = goal;
+    path_push_root(pf, (Uint32)start.y * w + (Uint32)start.x,
+                   path_octile(goal.x - start.x, goal.y - start.y));
+
+    while (pf->heap_len > 0)
+    {
+        Uint32 slot = path_pop(pf);
+        const PathNode *node = &pf->nodes[slot];
+        SDL_Point at = path_tile_point(pf, node->key);
+        if (at.x == goal.x && at.y == goal.y)
+        {
+            path_reconstruct(pf, slot, path, append, path_tile_point);
+            return true;
+        }
+
+        int dirs[8][2];
+        int n = path_prune(pf, box, node, at.x, at.y, dirs);
+        for (int i = 0; i < n; i++)
+        {
+            int dx = dirs[i][0], dy = dirs[i][1];
+            int x = at.x, y = at.y;
+            bool found = dx != 0 && dy != 0
+                             ? path_jump_diagonal(pf, box, &x, &y, dx, dy)
+                             : path_jump_straight(pf, box, &x, &y, dx, dy);
+            if (!found)
+                continue;
+
+            path_relax(pf, slot, (Uint32)y * w + (Uint32)x,
+                       node->g + path_octile(x - at.x, y - at.y),
+                       path_octile(goal.x - x, goal.y - y));
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Adds a tile to a flood's heap, as its cost in the high bits and its index
+ * in the low ones, so the cheapest comes first.
+ */
+void path_flood_push(Pathfinder *pf, Uint32 *len, Uint32 item)
+{
+    Uint32 pos = (*len)++;
+    while (pos > 0 && pf->flood_heap[(pos - 1) / 2] > item)
+    {
+        pf->flood_heap[pos] = pf->flood_heap[(pos - 1) / 2];
+        pos = (pos - 1) / 2;
+    }
+    pf->flood_heap[pos] = item;
+}
+
+/**
+ * Takes the cheapest tile out of a flood's heap.
+ */
+Uint32 path_flood_pop(Pathfinder *pf, Uint32 *len)
+{
+    Uint32 top = pf->flood_heap[0];
+    Uint32 item = pf->flood_heap[--(*len)];
+    Uint32 pos = 0;
+    for (;;)
+    {
+        Uint32 child = pos * 2 + 1;
+        if (child >= *len)
+            break;
+        if (child + 1 < *len &&
+            pf->flood_heap[child + 1] < pf->flood_heap[child])
+            child++;
+        if (pf->flood_heap[child] >= item)
+            break;
+
+        pf->flood_heap[pos] = pf->flood_heap[child];
+        pos = child;
+    }
+    pf->flood_heap[pos] = item;
+    return top;
+}
+
+/**
+ * Reaches every tile of a cluster's box from an open tile, with the cheapest
+ * cost. The costs are read with `path_flood_cost`, until the next flood.
+ * Floods don't touch the search buffers.
+ */
+void path_flood(Pathfinder *pf, const PathBox *box, SDL_Point start)
+{
+    int w = box->x1 - box->x0;
+    pf->flood_box = *box;
+    SDL_memset(pf->flood_cost, 0xFF, PATH_FLOOD_TILES * sizeof(Uint32));
+
+    Uint32 len = 0;
+    Uint32 first = (Uint32)((start.y - box->y0) * w + (start.x - box->x0));
+    pf->flood_cost[first] = 0;
+    path_flood_push(pf, &len, first);
+
+    while (len > 0)
+    {
+        Uint32 item = path_flood_pop(pf, &len);
+        Uint32 g = item >> 16, idx = item & 0xFFFF;
+        if (g > pf->flood_cost[idx])
+            continue; // Reached cheaper since it was pushed.
+
+        int ax = box->x0 + (int)idx % w, ay = box->y0 + (int)idx / w;
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                int x = ax + dx, y = ay + dy;
+                if ((dx == 0 && dy == 0) || !path_open(pf, box, x, y))
+                    continue;
+                if (dx != 0 && dy != 0 &&
+                    (!path_open(pf, box, x, ay) || !path_open(pf, box, ax, y)))
+                    continue;
+
+                Uint32 next = (Uint32)((y - box->y0) * w + (x - box->x0));
+                Uint32 cost = g + path_octile(dx, dy);
+                if (cost >= pf->flood_cost[next])
+                    continue;
+
+                pf->flood_cost[next] = cost;
+                path_flood_push(pf, &len, cost << 16 | next);
+            }
+        }
+    }
+}
+
+/**
+ * Retrieves the cost to a tile from the last flood, or PATH_NONE if it
+ * wasn't reached.
+ */
+Uint32 path_flood_cost(const Pathfinder *pf, SDL_Point p)
+{
+    const PathBox *box = &pf->flood_box;
+    if (p.x < box->x0 || p.y < box->y0 || p.x >= box->x1 || p.y >= box->y1)
+        return PATH_NONE;
+
+    int w = box->x1 - box->x0;
+    return pf->flood_cost[(p.y - box->y0) * w + (p.x - box->x0)];
+}
+
+/**
+ * Finds the entrances of a cluster, and the costs between them.
+ */
+void path_cluster_build(Pathfinder *pf, Uint32 index)
+{
+    PathCluster *cluster = &pf->clusters[index];
+    PathBox box = path_cluster_box(pf, index);
+    PathBox all = path_map_box(pf);
+
+    // Every side, as where it starts, its direction, and the way out.
+    const int sides[4][6] = {
+        [PATH_SIDE_N] = {box.x0, box.y0, 1, 0, 0, -1},
+        [PATH_SIDE_S] = {box.x0, box.y1 - 1, 1, 0, 0, 1},
+        [PATH_SIDE_W] = {box.x0, box.y0, 0, 1, -1, 0},
+        [PATH_SIDE_E] = {box.x1 - 1, box.y0, 0, 1, 1, 0},
+    };
+
+    Uint32 num = 0;
+    for (int side = 0; side < 4; side++)
+    {
+        const int *s = sides[side];
+        int len = s[2] ? box.x1 - box.x0 : box.y1 - box.y0;
+        cluster->first[side] = (Uint8)num;
+
+        int run = -1;
+        for (int i = 0; i <= len; i++)
+        {
+            int x = s[0] + s[2] * i, y = s[1] + s[3] * i;
+            bool open = i < len && path_open(pf, &all, x, y) &&
+                        path_open(pf, &all, x + s[4], y + s[5]);
+            if (open && run < 0)
+                run = i;
+            if (open || run < 0)
+                continue;
+
+            // A run of open tiles on both sides just ended.
+            int at[2] = {run, i - 1}, count = 2;
+            if (i - run < PATH_LONG_RUN)
+            {
+                at[0] = (run + i - 1) / 2;
+                count = 1;
+            }
+            for (int k = 0; k < count; k++)
+            {
+                if (num - cluster->first[side] >= PATH_MAX_SIDE_ENTRANCES)
+                    break;
+
+                int ex = s[0] + s[2] * at[k] - box.x0;
+                int ey = s[1] + s[3] * at[k] - box.y0;
+                cluster->entrances[num++] = (Uint16)(ey * MAP_CHUNK_SIZE + ex);
+            }
+            run = -1;
+        }
+    }
+    cluster->first[4] = (Uint8)num;
+
+    SDL_free(cluster->dist);
+    cluster->dist =
+        num > 0 ? SDL_malloc((size_t)num * num * sizeof(Uint16)) : NULL;
+    for (Uint32 i = 0; i < num; i++)
+    {
+        path_flood(pf, &box, path_entrance(pf, index, i));
+        for (Uint32 j = 0; j < num; j++)
+        {
+            Uint32 cost = path_flood_cost(pf, path_entrance(pf, index, j));
+            cluster->dist[i * num + j] =
+                cost == PATH_NONE ? PATH_UNREACHABLE : (Uint16)cost;
+        }
+    }
+
+    cluster->dirty = false;
+}
+
+/**
+ * Retrieves a cluster, building it first if its tiles changed since it was
+ * last built. Clusters are only built once a search reaches them.
+ */
+const PathCluster *path_cluster_get(Pathfinder *pf, Uint32 index)
+{
+    PathCluster *cluster = &pf->clusters[index];
+    if (cluster->dirty)
+        path_cluster_build(pf, index);
+    return cluster;
+}
+
+/**
+ * Relaxes the entrances reachable from an entrance of the cluster graph. The
+ * entrance's cluster was built when the entrance was reached.
+ */
+void path_expand_entrance(Pathfinder *pf, Uint32 slot, Uint32 goal_cluster,
+                          const Uint32 *goal_cost)
+{
+    const PathNode *node = &pf->nodes[slot];
+    Uint32 index = node->key / PATH_MAX_ENTRANCES;
+    Uint32 i = node->key % PATH_MAX_ENTRANCES;
+    const PathCluster *cluster = &pf->clusters[index];
+    Uint32 num = cluster->first[4];
+    Uint32 g = node->g;
+
+    if (index == goal_cluster && goal_cost[i] != PATH_NONE)
+        path_relax(pf, slot, PATH_KEY_GOAL, g + goal_cost[i], 0);
+
+    // Through the cluster.
+    for (Uint32 j = 0; j < num; j++)
+    {
+        Uint16 cost = cluster->dist[i * num + j];
+        if (j == i || cost == PATH_UNREACHABLE)
+            continue;
+
+        SDL_Point p = path_entrance(pf, index, j);
+        path_relax(pf, slot, index * PATH_MAX_ENTRANCES + j, g + cost,
+                   path_octile(pf->goal.x - p.x, pf->goal.y - p.y));
+    }
+
+    // Across to the next cluster, to the entrance facing this one.
+    int side = 0;
+    while (i >= cluster->first[side + 1])
+        side++;
+
+    Uint32 chunks_w = pf->map->chunks_w;
+    Uint32 next = side == PATH_SIDE_N   ? index - chunks_w
+                  : side == PATH_SIDE_S ? index + chunks_w
+                  : side == PATH_SIDE_W ? index - 1
+                                        : index + 1;
+    const PathCluster *other = path_cluster_get(pf, next);
+    Uint32 j = other->first[side ^ 1] + (i - cluster->first[side]);
+    if (j >= other->first[(side ^ 1) + 1])
+        return;
+
+    SDL_Point p = path_entrance(pf, next, j);
+    path_relax(pf, slot, next * PATH_MAX_ENTRANCES + j,
+               g + PATH_COST_STRAIGHT,
+               path_octile(pf->goal.x - p.x, pf->goal.y - p.y));
+}
+
+/**
+ * Finds a route over the cluster graph, then the tiles of every step of it.
+ */
+bool path_search_clusters(Pathfinder *pf, SDL_Point start, SDL_Point goal,
+                          Path *path)
+{
+    Uint32 from = path_cluster_of(pf, start), to = path_cluster_of(pf, goal);
+    Uint32 num_from = path_cluster_get(pf, from)->first[4];
+    Uint32 num_to = path_cluster_get(pf, to)->first[4];
+    Uint32 start_cost[PATH_MAX_ENTRANCES], goal_cost[PATH_MAX_ENTRANCES];
+    Uint32 direct = PATH_NONE;
+
+    // How the start and the goal connect to their clusters' entrances.
+    PathBox box = path_cluster_box(pf, from);
+    path_flood(pf, &box, start);
+    for (Uint32 i = 0; i < num_from; i++)
+        start_cost[i] = path_flood_cost(pf, path_entrance(pf, from, i));
+    if (from == to)
+        direct = path_flood_cost(pf, goal);
+
+    box = path_cluster_box(pf, to);
+    path_flood(pf, &box, goal);
+    for (Uint32 i = 0; i < num_to; i++)
+        goal_cost[i] = path_flood_cost(pf, path_entrance(pf, to, i));
+
+    path_begin(pf);
+    pf->start = start;
+    pf->goal = goal;
+    path_push_root(pf, PATH_KEY_START,
+                   path_octile(goal.x - start.x, goal.y - start.y));
+
+    bool found = false;
+    while (pf->heap_len > 0)
+    {
+        Uint32 slot = path_pop(pf);
+        Uint32 key = pf->nodes[slot].key;
+        if (key == PATH_KEY_GOAL)
+        {
+            path_reconstruct(pf, slot, &pf->route, false, path_route_point);
+            found = true;
+            break;
+        }
+        if (key != PATH_KEY_START)
+        {
+            path_expand_entrance(pf, slot, to, goal_cost);
+            continue;
+        }
+
+        if (direct != PATH_NONE)
+            path_relax(pf, slot, PATH_KEY_GOAL, direct, 0);
+        for (Uint32 i = 0; i < num_from; i++)
+        {
+            if (start_cost[i] == PATH_NONE)
+                continue;
+
+            SDL_Point p = path_entrance(pf, from, i);
+            path_relax(pf, slot, from * PATH_MAX_ENTRANCES + i, start_cost[i],
+                       path_octile(goal.x - p.x, goal.y - p.y));
+        }
+    }
+    if (!found)
+        return false;
+
+    // Every step of the route is either inside of a cluster, or across the
+    // edge between 2 clusters.
+    path->length = 1;
+    path_reserve(path, 1);
+    path->points[0] = start;
+    for (Uint32 i = 1; i < pf->route.length; i++)
+    {
+        SDL_Point a = pf->route.points[i - 1], b = pf->route.points[i];
+        Uint32 cluster = path_cluster_of(pf, a);
+        if (a.x == b.x && a.y == b.y)
+            continue;
+
+        if (cluster != path_cluster_of(pf, b))
+        {
+            path_reserve(path, path->length + 1);
+            path->points[path->length++] = b;
+            continue;
+        }
+
+        box = path_cluster_box(pf, cluster);
+        if (!path_search_jps(pf, &box, a, b, path, true))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Looks up a cached path.
+ */
+PathCacheEntry *path_cache_get(Pathfinder *pf, SDL_Point start,
+                               SDL_Point goal)
+{
+    for (int i = 0; i < PATH_CACHE_SIZE; i++)
+    {
+        PathCacheEntry *entry = &pf->cache[i];
+        if (entry->last_used && entry->start.x == start.x &&
+            entry->start.y == start.y && entry->goal.x == goal.x &&
+            entry->goal.y == goal.y)
+        {
+            entry->last_used = ++pf->uses;
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Keeps a path in the cache, in place of the one used the longest time ago.
+ */
+void path_cache_put(Pathfinder *pf, SDL_Point start, SDL_Point goal,
+                    const Path *path, bool found)
+{
+    PathCacheEntry *entry = &pf->cache[0];
+    for (int i = 1; i < PATH_CACHE_SIZE && entry->last_used; i++)
+    {
+        if (pf->cache[i].last_used < entry->last_used)
+            entry = &pf->cache[i];
+    }
+
+    entry->start = start;
+    entry->goal = goal;
+    entry->found = found;
+    entry->last_used = ++pf->uses;
+    path_copy(&entry->path, path);
+
+    // A missing path may appear after any edit. A found one only changes when
+    // its tiles, or the ones it walks diagonally past, do.
+    entry->bounds = path_map_box(pf);
+    if (!found)
+        return;
+
+    PathBox bounds = {start.x, start.y, start.x, start.y};
+    for (Uint32 i = 0; i < path->length; i++)
+    {
+        bounds.x0 = SDL_min(bounds.x0, path->points[i].x);
+        bounds.y0 = SDL_min(bounds.y0, path->points[i].y);
+        bounds.x1 = SDL_max(bounds.x1, path->points[i].x);
+        bounds.y1 = SDL_max(bounds.y1, path->points[i].y);
+    }
+    entry->bounds = (PathBox){bounds.x0 - 1, bounds.y0 - 1, bounds.x1 + 2,
+                              bounds.y1 + 2};
+}
+
+/**
+ * Keeps the solid tiles, the clusters and the cache in sync with the map.
+ */
+void pathfinder_on_map_change(struct Map *map, MapRegion region,
+                              void *userdata)
+{
+    Pathfinder *pf = userdata;
+
+    PathBox changed = {SDL_MAX_SINT32, SDL_MAX_SINT32, SDL_MIN_SINT32,
+                       SDL_MIN_SINT32};
+    for (Uint32 y = region.y; y < region.y + region.h; y++)
+    {
+        for (Uint32 x = region.x; x < region.x + region.w; x++)
+        {
+            if (!path_set_solid(pf, x, y,
+                                map_get_node(map, x, y).tile != TILE_AIR))
+                continue;
+
+            changed.x0 = SDL_min(changed.x0, (int)x);
+            changed.y0 = SDL_min(changed.y0, (int)y);
+            changed.x1 = SDL_max(changed.x1, (int)x + 1);
+            changed.y1 = SDL_max(changed.y1, (int)y + 1);
+        }
+    }
+    if (changed.x0 >= changed.x1)
+        return;
+
+    for (int i = 0; i < PATH_CACHE_SIZE; i++)
+    {
+        PathCacheEntry *entry = &pf->cache[i];
+        if (entry->bounds.x0 < changed.x1 && changed.x0 < entry->bounds.x1 &&
+            entry->bounds.y0 < changed.y1 && changed.y0 < entry->bounds.y1)
+            entry->last_used = 0;
+    }
+
+    if (!pf->clusters)
+        return;
+
+    // The entrances on an edge also depend on the tiles across it.
+    int x0 = SDL_max(changed.x0 - 1, 0) / MAP_CHUNK_SIZE;
+    int y0 = SDL_max(changed.y0 - 1, 0) / MAP_CHUNK_SIZE;
+    int x1 = SDL_min(changed.x1, (int)map->w - 1) / MAP_CHUNK_SIZE;
+    int y1 = SDL_min(changed.y1, (int)map->h - 1) / MAP_CHUNK_SIZE;
+    for (int cy = y0; cy <= y1; cy++)
+    {
+        for (int cx = x0; cx <= x1; cx++)
+            pf->clusters[(Uint32)cy * map->chunks_w + (Uint32)cx].dirty = true;
+    }
+}
+
+Pathfinder *pathfinder_init(Map *map, bool clusters)
+{
+    Pathfinder *pf = SDL_calloc(1, sizeof(Pathfinder));
+    pf->map = map;
+    pf->stride = (map->w + 63) / 64;
+    pf->solid = SDL_calloc((size_t)pf->stride * map->h, sizeof(Uint64));
+    pf->nodes = SDL_calloc(PATH_MAX_NODES, sizeof(PathNode));
+    pf->heap = SDL_malloc(PATH_MAX_NODES * sizeof(Uint32));
+    pf->flood_cost = SDL_malloc(PATH_FLOOD_TILES * sizeof(Uint32));
+    pf->flood_heap = SDL_malloc(PATH_FLOOD_HEAP * sizeof(Uint32));
+
+    if (clusters)
+    {
+        pf->num_clusters = map->chunks_w * map->chunks_h;
+        pf->clusters = SDL_calloc(pf->num_clusters, sizeof(PathCluster));
+    }
+
+    if (!pf->solid || !pf->nodes || !pf->heap || !pf->flood_cost ||
+        !pf->flood_heap || (clusters && !pf->clusters))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to create the pathfinder of map %s", map->name);
+        pathfinder_destroy(pf);
+        return NULL;
+    }
+
+    for (Uint32 i = 0; i < map->num_chunks; i++)
+    {
+        const MapChunk *chunk = map->chunk_list[i];
+        Uint32 x0 = chunk->cx * MAP_CHUNK_SIZE, y0 = chunk->cy * MAP_CHUNK_SIZE;
+        Uint32 w = SDL_min(MAP_CHUNK_SIZE, map->w - x0);
+        Uint32 h = SDL_min(MAP_CHUNK_SIZE, map->h - y0);
+        for (Uint32 y = 0; y < h; y++)
+        {
+            for (Uint32 x = 0; x < w; x++)
+            {
+                MapCell cell = chunk->cells[y * MAP_CHUNK_SIZE + x];
+                if (MAP_CELL_TILE(cell) != TILE_AIR)
+                    path_set_solid(pf, x0 + x, y0 + y, true);
+            }
+        }
+    }
+
+    // Clusters are built when a search first reaches them.
+    for (Uint32 i = 0; i < pf->num_clusters; i++)
+        pf->clusters[i].dirty = true;
+
+    map_add_listener(map, pathfinder_on_map_change, pf);
+    return pf;
+}
+
+PathState pathfinder_find(Pathfinder *pf, SDL_Point start, SDL_Point goal,
+                          Path *path)
+{
+    PathBox all = path_map_box(pf);
+    path->length = 0;
+    path->cost = 0;
+    if (!path_open(pf, &all, start.x, start.y) ||
+        !path_open(pf, &all, goal.x, goal.y))
+        return PATH_STATE_NOT_FOUND;
+
+    PathCacheEntry *entry = path_cache_get(pf, start, goal);
+    if (entry)
+    {
+        path_copy(path, &entry->path);
+        return entry->found ? PATH_STATE_FOUND : PATH_STATE_NOT_FOUND;
+    }
+
+    bool found;
+    Uint32 distance = path_octile(goal.x - start.x, goal.y - start.y);
+    if (pf->clusters && distance > PATH_DIRECT_RANGE * PATH_COST_STRAIGHT)
+    {
+        found = path_search_clusters(pf, start, goal, path);
+    }
+    else
+    {
+        found = path_search_jps(pf, &all, start, goal, path, false);
+        if (!found && pf->exhausted && pf->clusters)
+            found = path_search_clusters(pf, start, goal, path);
+    }
+
+    if (found)
+    {
+        for (Uint32 i = 1; i < path->length; i++)
+        {
+            SDL_Point a = path->points[i - 1], b = path->points[i];
+            path->cost += path_octile(b.x - a.x, b.y - a.y);
+        }
+    }
+    else
+    {
+        path->length = 0;
+    }
+
+    path_cache_put(pf, start, goal, path, found);
+    return found ? PATH_STATE_FOUND : PATH_STATE_NOT_FOUND;
+}
+
+void pathfinder_submit(Pathfinder *pf, PathRequest *req)
+{
+    req->state = PATH_STATE_PENDING;
+    if (req->queued)
+        return;
+
+    if (!array_push(&pf->queue, req))
+    {
+        req->state = PATH_STATE_IDLE;
+        return;
+    }
+    req->queued = true;
+}
+
+void pathfinder_cancel(Pathfinder *pf, PathRequest *req)
+{
+    if (!req->queued)
+        return;
+
+    for (Uint32 i = 0; i < pf->queue.length; i++)
+    {
+        if (pf->queue.items[i] == req)
+        {
+            array_remove_at(&pf->queue, i);
+            break;
+        }
+    }
+
+    req->queued = false;
+    req->state = PATH_STATE_IDLE;
+}
+
+void pathfinder_update(Pathfinder *pf, Uint64 budget_ns)
+{
+    Uint64 deadline = SDL_GetTicksNS() + budget_ns;
+
+    // Oldest first, so every agent gets its turn.
+    Uint32 done = 0;
+    while (done < pf->queue.length && SDL_GetTicksNS() < deadline)
+    {
+        PathRequest *req = pf->queue.items[done++];
+        req->queued = false;
+        req->state = pathfinder_find(pf, req->start, req->goal, &req->path);
+    }
+
+    if (done == 0)
+        return;
+
+    pf->queue.length -= done;
+    SDL_memmove(pf->queue.items, pf->queue.items + done,
+                pf->queue.length * sizeof(PathRequest *));
+}
+
+void path_free(Path *path)
+{
+    SDL_free(path->points);
+    *path = (Path){0};
+}
+
+void pathfinder_destroy(Pathfinder *pf)
+{
+    if (!pf)
+        return;
+
+    map_remove_listener(pf->map, pathfinder_on_map_change, pf);
+
+    for (Uint32 i = 0; i < pf->queue.length; i++)
+        pf->queue.items[i]->queued = false;
+    array_free(&pf->queue);
+
+    for (int i = 0; i < PATH_CACHE_SIZE; i++)
+        path_free(&pf->cache[i].path);
+    for (Uint32 i = 0; pf->clusters && i < pf->num_clusters; i++)
+        SDL_free(pf->clusters[i].dist);
+
+    path_free(&pf->route);
+    SDL_free(pf->clusters);
+    SDL_free(pf->flood_cost);
+    SDL_free(pf->flood_heap);
+    SDL_free(pf->heap);
+    SDL_free(pf->nodes);
+    SDL_free(pf->solid);
+    SDL_free(pf);
+}
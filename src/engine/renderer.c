@@ -43,7 +43,7 @@ void shift_position_to_origin(RenderingOriginType type, double *x, double *y,
     }
 }
 
-void render_map(Map *map, Sprite *spr)
+void render_map(Map *map, SpriteSheet *sheet)
 {
     // We want to align the map to the bottom of the screen. But the map
     // was written with coords relative to the top of the map.
@@ -52,50 +52,53 @@ void render_map(Map *map, Sprite *spr)
     // coords.
     AppState *appstate = app_get();
 
+    // Look up each tile type's tag once, instead of once per tile.
+    int tags[NUM_MAP_TILES];
+    for (int i = 0; i < NUM_MAP_TILES; i++)
+        tags[i] = map_tile_tag(sheet, (MapTile)i);
+
     // Let's render (0, maxY) = bottom left. That means local_x * 16 = screen_x.
     // (0, maxY-1) = 1 off bottom => screen_y = win_y - (max_y - local_y) * 16.
-    for (Uint32 x = 0; x < map->w; x++)
+    // Only the chunks in memory have anything to draw.
+    for (Uint32 c = 0; c < map->num_chunks; c++)
     {
-        for (Uint32 y = 0; y < map->h; y++)
+        const MapChunk *chunk = map->chunk_list[c];
+        Uint32 chunk_x = chunk->cx * MAP_CHUNK_SIZE;
+        Uint32 chunk_y = chunk->cy * MAP_CHUNK_SIZE;
+        for (Uint32 i = 0; i < MAP_CHUNK_SIZE * MAP_CHUNK_SIZE; i++)
         {
             // First, we calculate the srcrect.
             // A sprite is expected to have the following order in 12:
             // solo, nw, n, ne, w, c, e, sw, s, se, vert, horiz
-            MapNode node = map->tiles[y * map->w + x];
+            MapCell cell = chunk->cells[i];
+            MapTile tile = MAP_CELL_TILE(cell);
 
-            // Ignore if is air.
-            if (node.tile == TILE_AIR)
+            // Ignore if is air. Chunks on the edges are only partly in the map,
+            // and the rest of them is always air.
+            if (tile == TILE_AIR)
             {
                 continue;
             }
 
-            map_tile_sprite(spr, node.tile);
+            Uint32 x = chunk_x + i % MAP_CHUNK_SIZE;
+            Uint32 y = chunk_y + i / MAP_CHUNK_SIZE;
 
             // Get the frame we're gonna draw.
             SDL_FRect srcrect, dstrect;
-            SpriteFrame frame;
-            if (spr->sel_tag >= 0)
-            {
-                FrameTag tag = spr->tags[spr->sel_tag];
-                frame = spr->frames[tag.from + (Uint32)node.dir];
-            }
-            else
-            {
-                frame = spr->frames[node.dir];
-            }
+            const SpriteFrame *frame = sprite_sheet_frame(
+                sheet, tags[tile], (Uint32)MAP_CELL_DIR(cell));
 
             // Then we compute the srcrect and dstrect to draw.
-            srcrect = frame.frame;
+            srcrect = frame->frame;
 
-            dstrect.x = x * APPLICATION_MAP_TILE * APPLICATION_SCALE;
-            dstrect.y = (Uint32)appstate->window.h - (map->h - y - 1) *
-                                                         APPLICATION_MAP_TILE *
-                                                         APPLICATION_SCALE;
-            dstrect.w = APPLICATION_MAP_TILE * APPLICATION_SCALE;
-            dstrect.h = APPLICATION_MAP_TILE * APPLICATION_SCALE;
+            dstrect.x = x * APPLICATION_MAP_TILE;
+            dstrect.y = (Uint32)appstate->window.logical_h -
+                        (map->h - y - 1) * APPLICATION_MAP_TILE;
+            dstrect.w = APPLICATION_MAP_TILE;
+            dstrect.h = APPLICATION_MAP_TILE;
 
             render_aligned_texture((RenderingOptions){
-                .texture = spr->texture,
+                .texture = sheet->texture,
                 .origin = RENDER_ORIGIN_BOTTOM_LEFT,
                 .srcrect = &srcrect,
                 .dstrect = &dstrect,
@@ -129,16 +132,7 @@ void render_aligned_texture(RenderingOptions options)
 void render_sprite(Sprite *spr, Vector2 pos)
 {
     // Get the current texture.
-    SpriteFrame *frame = NULL;
-    if (spr->sel_tag < 0)
-    {
-        frame = &spr->frames[spr->frame_idx];
-    }
-    else
-    {
-        FrameTag tag = spr->tags[spr->sel_tag];
-        frame = &spr->frames[spr->frame_idx + tag.from];
-    }
+    const SpriteFrame *frame = sprite_current_frame(spr);
 
     SDL_FRect srcrect, dstrect;
     srcrect = frame->frame;
@@ -149,7 +143,7 @@ void render_sprite(Sprite *spr, Vector2 pos)
 
     RenderingOptions opts = {
         .origin = RENDER_ORIGIN_MIDDLE_CENTER,
-        .texture = spr->texture,
+        .texture = spr->sheet->texture,
         .srcrect = &srcrect,
         .dstrect = &dstrect,
     };
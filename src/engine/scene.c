@@ -1,12 +1,16 @@
 #include "engine/scene.h"
 #include "SDL3/SDL_assert.h"
 #include "SDL3/SDL_blendmode.h"
+#include "SDL3/SDL_error.h"
 #include "SDL3/SDL_log.h"
 #include "SDL3/SDL_pixels.h"
 #include "SDL3/SDL_rect.h"
 #include "SDL3/SDL_render.h"
 #include "SDL3/SDL_stdinc.h"
 #include "app.h"
+#include "engine/assets.h"
+#include "engine/loader.h"
+#include "engine/target_pool.h"
 #include "misc/hashmap.h"
 #include "misc/list.h"
 #include "misc/stack.h"
@@ -22,9 +26,25 @@ Scene *scene_init(void)
     scene->id = SCENE_ID_EMPTY;
     scene->colliders = hash_map_init();
     scene->sprites = hash_map_init();
+    scene->opacity = 1;
+    scene->dirty = true;
     return scene;
 }
 
+void scene_mark_dirty(Scene *scene)
+{
+    scene->dirty = true;
+}
+
+bool scene_acquire_assets(Scene *scene)
+{
+    if (scene->assets_held || scene->num_assets == 0)
+        return true;
+
+    scene->assets_held = assets_preload(scene->assets, scene->num_assets);
+    return scene->assets_held;
+}
+
 void scene_destroy(Scene *scene)
 {
     if (!scene)
@@ -33,6 +53,9 @@ void scene_destroy(Scene *scene)
     if (scene->ondestroy)
         scene->ondestroy(scene);
 
+    if (scene->assets_held)
+        assets_release_list(scene->assets, scene->num_assets);
+
     hash_map_destroy(scene->colliders);
     hash_map_destroy(scene->sprites);
     SDL_free(scene);
@@ -44,15 +67,14 @@ void scene_destroy(Scene *scene)
 void scene_mgr_purge_transitions(SceneManager *mgr)
 {
     Uint32 i = 0;
-    while (i < mgr->transitions->length)
+    while (i < mgr->transitions.length)
     {
-        SceneTransition *trans = (SceneTransition *)mgr->transitions->items[i];
+        SceneTransition *trans = &mgr->transitions.items[i];
         if (!trans->active)
         {
-            list_remove_at(mgr->transitions, i);
-            SDL_DestroyTexture(trans->from_txt);
-            SDL_DestroyTexture(trans->to_txt);
-            SDL_free(trans);
+            target_pool_release(mgr->targets, trans->from_txt);
+            target_pool_release(mgr->targets, trans->to_txt);
+            array_remove_at(&mgr->transitions, i);
         }
         else
         {
@@ -61,6 +83,24 @@ void scene_mgr_purge_transitions(SceneManager *mgr)
     }
 }
 
+/**
+ * Retrieves the active transition for the scene. This is definitely a slow
+ * operation since it's doing this for every single scene. But if there are
+ * maximum like 5 scenes at play, and therefore 5 transitions max, it's 25
+ * pointer checks per frame, which is negligible compared to loading textures.
+ */
+SceneTransition *scene_get_active_transition(SceneManager *mgr, Scene *scene)
+{
+    for (Uint32 i = 0; i < mgr->transitions.length; i++)
+    {
+        SceneTransition *trans = &mgr->transitions.items[i];
+        if (trans->active && trans->from_scene == scene)
+            return trans;
+    }
+
+    return NULL;
+}
+
 /**
  * Just makes it so the transitioning scenes render their scenes on the provided
  * texture.
@@ -73,15 +113,25 @@ void scene_mgr_transition_render(SceneManager *mgr, SceneTransition *trans)
     WindowStatus win = appstate->window;
     SDL_Texture *target = SDL_GetRenderTarget(win.renderer);
 
-    // Render the from scene first.
-    SDL_SetRenderTarget(win.renderer, trans->from_txt);
-    if (trans->from_scene->ondraw)
+    // Render the from scene first. If the transition stops physics, the from
+    // scene can't change, so it's drawn once and the snapshot is reused.
+    if (!trans->stops_physics || !trans->from_captured ||
+        trans->from_scene->dirty)
     {
-        trans->from_scene->ondraw(trans->from_scene, win.renderer);
+        SDL_SetRenderDrawColor(win.renderer, 255, 255, 255, 0);
+        SDL_SetRenderTarget(win.renderer, trans->from_txt);
+        SDL_RenderClear(win.renderer);
+        if (trans->from_scene->ondraw)
+        {
+            trans->from_scene->ondraw(trans->from_scene, win.renderer);
+        }
+        trans->from_captured = true;
     }
 
     // Render the to scene then.
+    SDL_SetRenderDrawColor(win.renderer, 255, 255, 255, 0);
     SDL_SetRenderTarget(win.renderer, trans->to_txt);
+    SDL_RenderClear(win.renderer);
     if (trans->to_scene->ondraw)
     {
         trans->to_scene->ondraw(trans->to_scene, win.renderer);
@@ -123,8 +173,8 @@ void scene_mgr_transition_render_fade(SceneManager *mgr, SceneTransition *trans,
     SDL_FRect dstrect = {
         .x = 0,
         .y = 0,
-        .h = win.h,
-        .w = win.w,
+        .h = win.logical_h,
+        .w = win.logical_w,
     };
 
     SDL_RenderTexture(win.renderer, trans->to_txt, NULL, &dstrect);
@@ -151,13 +201,13 @@ void scene_mgr_transition_render_slide_left(SceneManager *mgr,
     SDL_FRect dstrect = {
         .x = 0,
         .y = 0,
-        .h = win.h,
-        .w = win.w,
+        .h = win.logical_h,
+        .w = win.logical_w,
     };
     SDL_RenderTexture(win.renderer, trans->to_txt, NULL, &dstrect);
 
     // Then render the from_scene above, but offset by a slight amount.
-    dstrect.x -= (float)(progress * win.w);
+    dstrect.x -= (float)(progress * win.logical_w);
     SDL_RenderTexture(win.renderer, trans->from_txt, NULL, &dstrect);
 }
 
@@ -177,10 +227,10 @@ void scene_mgr_transition_render_push_up(SceneManager *mgr,
     SDL_FRect dstrect = {
         .x = 0,
         .y = 0,
-        .h = win.h,
-        .w = win.w,
+        .h = win.logical_h,
+        .w = win.logical_w,
     };
-    dstrect.y -= (float)(win.h * progress);
+    dstrect.y -= (float)(win.logical_h * progress);
     SDL_RenderTexture(win.renderer, trans->from_txt, NULL, &dstrect);
 
     // Render the to_scene.
@@ -204,10 +254,10 @@ void scene_mgr_transition_render_push_down(SceneManager *mgr,
     SDL_FRect dstrect = {
         .x = 0,
         .y = 0,
-        .h = win.h,
-        .w = win.w,
+        .h = win.logical_h,
+        .w = win.logical_w,
     };
-    dstrect.y += (float)(win.h * progress);
+    dstrect.y += (float)(win.logical_h * progress);
     SDL_RenderTexture(win.renderer, trans->from_txt, NULL, &dstrect);
 
     // Render the to_scene.
@@ -231,10 +281,10 @@ void scene_mgr_transition_render_push_left(SceneManager *mgr,
     SDL_FRect dstrect = {
         .x = 0,
         .y = 0,
-        .h = win.h,
-        .w = win.w,
+        .h = win.logical_h,
+        .w = win.logical_w,
     };
-    dstrect.x -= (float)(win.w * progress);
+    dstrect.x -= (float)(win.logical_w * progress);
     SDL_RenderTexture(win.renderer, trans->from_txt, NULL, &dstrect);
 
     // Render the to_scene.
@@ -258,10 +308,10 @@ void scene_mgr_transition_render_push_right(SceneManager *mgr,
     SDL_FRect dstrect = {
         .x = 0,
         .y = 0,
-        .h = win.h,
-        .w = win.w,
+        .h = win.logical_h,
+        .w = win.logical_w,
     };
-    dstrect.x += (float)(win.w * progress);
+    dstrect.x += (float)(win.logical_w * progress);
     SDL_RenderTexture(win.renderer, trans->from_txt, NULL, &dstrect);
 
     // Render the to_scene.
@@ -288,8 +338,14 @@ void scene_mgr_handle_transition(SceneManager *mgr, SceneTransition *trans,
     if (trans->elapsed > trans->duration)
     {
         trans->active = false; // Mark for deletion.
+        mgr->dirty = true;
         SDL_assert(trans->from_scene != NULL && trans->to_scene != NULL);
 
+        // The scenes' callbacks may start other transitions, which can move
+        // the transitions around, so keep what's needed.
+        SceneTransition ended = *trans;
+        trans = &ended;
+
         // Do the actual scene swapping.
         // Since the scene being swapped may not be on top of the stack, we want
         // to swap in place.
@@ -324,27 +380,338 @@ void scene_mgr_handle_transition(SceneManager *mgr, SceneTransition *trans,
     trans->elapsed += dt;
 }
 
-void scene_mgr_tick(SceneManager *mgr, double dt)
+/**
+ * Finds the index of the lowest visible scene in the stack. That is the
+ * topmost scene that hides everything below it, or 0 if there is none.
+ *
+ * A scene in a transition or drawn with group alpha never hides anything, as
+ * the scenes below can show through.
+ */
+int scene_mgr_first_visible(SceneManager *mgr)
+{
+    for (int i = mgr->scenes->length - 1; i > 0; i--)
+    {
+        Scene *scene = (Scene *)mgr->scenes->items[i];
+        if (!scene || !scene->enabled || !scene->opaque || scene->opacity < 1)
+            continue;
+
+        if (scene_get_active_transition(mgr, scene) == NULL)
+            return i;
+    }
+
+    return 0;
+}
+
+/**
+ * Checks if the scene is frozen by a transition that stops physics.
+ */
+bool scene_mgr_is_frozen(SceneManager *mgr, Scene *scene)
+{
+    SceneTransition *trans = scene_get_active_transition(mgr, scene);
+    return trans != NULL && trans->stops_physics;
+}
+
+/**
+ * Finds the index of a scene in the stack. Returns -1 if it's not there.
+ */
+int scene_mgr_find_scene(SceneManager *mgr, Scene *scene)
+{
+    for (int i = 0; i < mgr->scenes->length; i++)
+    {
+        if (mgr->scenes->items[i] == scene)
+            return i;
+    }
+
+    return -1;
+}
+
+/**
+ * Starts a transition whose to_scene is ready. Returns false if it couldn't
+ * be started.
+ */
+bool scene_mgr_begin_transition(SceneManager *mgr,
+                                const SceneTransition *transition)
+{
+    AppState *appstate = app_get();
+    WindowStatus win = appstate->window;
+
+    if (scene_mgr_find_scene(mgr, transition->from_scene) < 0)
+    {
+        SDL_LogError(
+            SDL_LOG_CATEGORY_APPLICATION,
+            "Scene Transition called with a scene that does not exist yet.");
+        return false;
+    }
+
+    SceneTransition trans = *transition;
+    trans.from_captured = false;
+
+    // Borrow the targets, so starting a transition doesn't allocate.
+    trans.from_txt =
+        target_pool_acquire(mgr->targets, win.logical_w, win.logical_h,
+                            SDL_PIXELFORMAT_RGBA8888);
+    trans.to_txt =
+        target_pool_acquire(mgr->targets, win.logical_w, win.logical_h,
+                            SDL_PIXELFORMAT_RGBA8888);
+
+    if (!trans.from_txt || !trans.to_txt ||
+        !array_push(&mgr->transitions, trans))
+    {
+        SDL_Log("Failed to create transition textures: %s", SDL_GetError());
+        target_pool_release(mgr->targets, trans.from_txt);
+        target_pool_release(mgr->targets, trans.to_txt);
+        return false;
+    }
+
+    // Initialize the to transition. Its assets are resident by now, so this
+    // doesn't touch the disk.
+    if (transition->to_scene->oninit)
+    {
+        transition->to_scene->oninit(transition->to_scene);
+    }
+    return true;
+}
+
+/**
+ * Starts loading the assets of a transition's to_scene. Assets someone
+ * already holds, like the from_scene, are acquired right away.
+ */
+ScenePreparation *scene_mgr_prepare(const SceneTransition *transition)
+{
+    Scene *scene = transition->to_scene;
+    ScenePreparation *prep = SDL_calloc(1, sizeof(ScenePreparation));
+    prep->transition = *transition;
+    if (scene->assets_held || scene->num_assets == 0)
+        return prep;
+
+    prep->requests = SDL_calloc(scene->num_assets, sizeof(LoadRequest *));
+    prep->held = SDL_calloc(scene->num_assets, sizeof(bool));
+    for (Uint32 i = 0; i < scene->num_assets; i++)
+    {
+        const AssetRef *ref = &scene->assets[i];
+        if (assets_hold(ref->type, ref->name))
+        {
+            prep->held[i] = true;
+            continue;
+        }
+
+        prep->requests[i] = loader_request(ref->type, ref->name);
+        if (prep->requests[i])
+            prep->num_pending++;
+        else
+            prep->failed = true;
+    }
+
+    return prep;
+}
+
+/**
+ * Hands the finished loads of a preparation over to the asset registry.
+ * Returns true once every load is finished.
+ */
+bool scene_mgr_poll_preparation(ScenePreparation *prep)
+{
+    const Scene *scene = prep->transition.to_scene;
+    for (Uint32 i = 0; prep->num_pending > 0 && i < scene->num_assets; i++)
+    {
+        LoadRequest *req = prep->requests[i];
+        if (!req || !loader_is_finished(req))
+            continue;
+
+        const AssetRef *ref = &scene->assets[i];
+        void *data = loader_take_result(req);
+        if (data)
+        {
+            assets_adopt(ref->type, ref->name, data);
+            prep->held[i] = true;
+        }
+        else
+        {
+            prep->failed = true;
+        }
+
+        loader_release(req);
+        prep->requests[i] = NULL;
+        prep->num_pending--;
+    }
+
+    return prep->num_pending == 0;
+}
+
+/**
+ * Frees a preparation. Loads still going are given back, and the assets it
+ * acquired are released, unless they were handed over to the scene.
+ */
+void scene_mgr_free_preparation(ScenePreparation *prep)
+{
+    const Scene *scene = prep->transition.to_scene;
+    for (Uint32 i = 0; prep->held && i < scene->num_assets; i++)
+    {
+        loader_release(prep->requests[i]);
+        if (prep->held[i])
+            assets_release(scene->assets[i].type, scene->assets[i].name);
+    }
+
+    SDL_free(prep->requests);
+    SDL_free(prep->held);
+    SDL_free(prep);
+}
+
+/**
+ * Starts the transition of a finished preparation, and frees it.
+ */
+void scene_mgr_finish_preparation(SceneManager *mgr, ScenePreparation *prep)
+{
+    Scene *scene = prep->transition.to_scene;
+    if (prep->failed)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to load the assets of scene %d", scene->id);
+        scene_mgr_free_preparation(prep);
+        scene_destroy(scene);
+        return;
+    }
+
+    // The scene holds the assets from now on.
+    if (prep->held)
+    {
+        scene->assets_held = true;
+        SDL_free(prep->held);
+        prep->held = NULL;
+    }
+
+    if (!scene_mgr_begin_transition(mgr, &prep->transition))
+        scene_destroy(scene);
+    scene_mgr_free_preparation(prep);
+}
+
+/**
+ * Shows or hides the loading scene on top of the stack.
+ */
+void scene_mgr_show_loading(SceneManager *mgr, bool show, float progress)
+{
+    Scene *loading = mgr->loading;
+    if (!loading)
+        return;
+
+    int idx = scene_mgr_find_scene(mgr, loading);
+    if (!show)
+    {
+        if (idx < 0)
+            return;
+
+        SDL_memmove(&mgr->scenes->items[idx], &mgr->scenes->items[idx + 1],
+                    sizeof(void *) * (size_t)(mgr->scenes->length - idx - 1));
+        mgr->scenes->length--;
+        mgr->dirty = true;
+        return;
+    }
+
+    if (idx < 0)
+    {
+        if (!stack_push(mgr->scenes, loading))
+            return;
+        mgr->dirty = true;
+    }
+
+    if (loading->data.loading.progress != progress)
+    {
+        loading->data.loading.progress = progress;
+        scene_mark_dirty(loading);
+    }
+}
+
+/**
+ * Moves the scenes being loaded along, and starts the transitions of those
+ * that are ready.
+ */
+void scene_mgr_update_preparations(SceneManager *mgr, double dt)
+{
+    Uint32 loaded = 0, total = 0;
+    bool slow = false;
+
+    Uint32 i = 0;
+    while (i < mgr->preparing->length)
+    {
+        ScenePreparation *prep = mgr->preparing->items[i];
+        prep->elapsed += dt;
+        if (scene_mgr_poll_preparation(prep))
+        {
+            list_remove_at(mgr->preparing, i);
+            scene_mgr_finish_preparation(mgr, prep);
+            continue;
+        }
+
+        Uint32 num_assets = prep->transition.to_scene->num_assets;
+        total += num_assets;
+        loaded += num_assets - prep->num_pending;
+        slow = slow || prep->elapsed >= SCENE_LOADING_DELAY;
+        i++;
+    }
+
+    scene_mgr_show_loading(mgr, slow,
+                           total == 0 ? 1 : (float)loaded / (float)total);
+}
+
+void scene_mgr_start_transition(SceneManager *mgr, SceneTransition transition)
+{
+    if (scene_mgr_find_scene(mgr, transition.from_scene) < 0)
+    {
+        SDL_LogError(
+            SDL_LOG_CATEGORY_APPLICATION,
+            "Scene Transition called with a scene that does not exist yet.");
+        return;
+    }
+
+    // Nothing to wait for, the transition starts this frame.
+    ScenePreparation *prep = scene_mgr_prepare(&transition);
+    if (prep->num_pending == 0)
+    {
+        scene_mgr_finish_preparation(mgr, prep);
+        return;
+    }
+
+    list_add(mgr->preparing, prep);
+}
+
+void scene_mgr_cancel_preparations(SceneManager *mgr)
 {
-    // Handle the transitions.
-    for (int i = 0; i < (int)mgr->transitions->length; i++)
+    for (Uint32 i = 0; i < mgr->preparing->length; i++)
     {
-        SceneTransition *trans = (SceneTransition *)mgr->transitions->items[i];
-        scene_mgr_handle_transition(mgr, trans, dt);
+        ScenePreparation *prep = mgr->preparing->items[i];
+        Scene *scene = prep->transition.to_scene;
+        scene_mgr_free_preparation(prep);
+        scene_destroy(scene);
     }
 
+    list_clear(mgr->preparing);
+    scene_mgr_show_loading(mgr, false, 0);
+}
+
+void scene_mgr_tick(SceneManager *mgr, double dt)
+{
+    // Start the transitions whose scenes finished loading.
+    scene_mgr_update_preparations(mgr, dt);
+
+    // Handle the transitions. Scenes may start new ones while this runs, so
+    // they are looked up by index.
+    for (Uint32 i = 0; i < mgr->transitions.length; i++)
+        scene_mgr_handle_transition(mgr, &mgr->transitions.items[i], dt);
+
     // We want to let top scenes capture focus if needed. So we iterate from top
-    // to bottom.
+    // to bottom. Hidden scenes don't need a tick, as nobody sees them.
     bool focus_captured = false;
-    for (int i = mgr->scenes->length - 1; i >= 0; i--)
+    int first = scene_mgr_first_visible(mgr);
+    for (int i = mgr->scenes->length - 1; i >= first; i--)
     {
         Scene *scene = (Scene *)mgr->scenes->items[i];
         if (!scene)
             continue;
 
         // A scene only receives a tick if focus is not captured yet, and it is
-        // enabled.
-        if (scene->enabled && !focus_captured && scene->ontick)
+        // enabled, and not frozen.
+        if (scene->enabled && !focus_captured && scene->ontick &&
+            !scene_mgr_is_frozen(mgr, scene))
         {
             scene->ontick(scene, dt);
         }
@@ -366,8 +733,9 @@ void scene_mgr_phys_tick(SceneManager *mgr)
             return;
 
         // A scene gets a physical tick if focus is not captured and the scene
-        // is enabled.
-        if (scene->enabled && scene->onphystick && !focus_captured)
+        // is enabled, and not frozen.
+        if (scene->enabled && scene->onphystick && !focus_captured &&
+            !scene_mgr_is_frozen(mgr, scene))
         {
             scene->onphystick(scene);
         }
@@ -375,165 +743,328 @@ void scene_mgr_phys_tick(SceneManager *mgr)
     }
 }
 
-void scene_mgr_start_transition(SceneManager *mgr, SceneTransition transition)
+/**
+ * Tells a scene the logical resolution changed.
+ */
+void scene_resize(Scene *scene, int w, int h)
 {
-    AppState *appstate = app_get();
-    WindowStatus win = appstate->window;
+    if (!scene)
+        return;
 
-    bool found = false;
+    scene->dirty = true;
+    if (scene->onresize)
+        scene->onresize(scene, w, h);
+}
+
+/**
+ * Tells every scene the scene manager holds, on the stack or not yet, that the
+ * logical resolution changed. Scenes are expected to handle being told twice.
+ */
+void scene_mgr_resize_scenes(SceneManager *mgr, int w, int h)
+{
     for (int i = 0; i < mgr->scenes->length; i++)
+        scene_resize(mgr->scenes->items[i], w, h);
+
+    // The scenes being transitioned to may not be on the stack yet.
+    for (Uint32 i = 0; i < mgr->transitions.length; i++)
+        scene_resize(mgr->transitions.items[i].to_scene, w, h);
+
+    for (Uint32 i = 0; i < mgr->preparing->length; i++)
     {
-        if (mgr->scenes->items[i] == transition.from_scene)
-        {
-            found = true;
-            break;
-        }
+        ScenePreparation *prep = mgr->preparing->items[i];
+        scene_resize(prep->transition.to_scene, w, h);
     }
 
-    if (!found)
+    // The loading scene is only on the stack while it's shown.
+    if (scene_mgr_find_scene(mgr, mgr->loading) < 0)
+        scene_resize(mgr->loading, w, h);
+}
+
+bool scene_mgr_resize(SceneManager *mgr, int w, int h)
+{
+    mgr->dirty = true;
+
+    // Resizing the window by a pixel may not change the logical size at all.
+    if (!target_pool_resize(mgr->targets, w, h) && mgr->canvas && mgr->target)
+        return true;
+
+    // Scenes that cover the screen have to keep covering it, or what's outside
+    // of them would show whatever the new canvas holds.
+    scene_mgr_resize_scenes(mgr, w, h);
+
+    target_pool_release(mgr->targets, mgr->canvas);
+    target_pool_release(mgr->targets, mgr->target);
+    target_pool_release(mgr->targets, mgr->snapshot);
+    mgr->snapshot = NULL;
+
+    mgr->canvas =
+        target_pool_acquire(mgr->targets, w, h, SDL_PIXELFORMAT_RGBA8888);
+    mgr->target =
+        target_pool_acquire(mgr->targets, w, h, SDL_PIXELFORMAT_RGBA8888);
+    if (!mgr->canvas || !mgr->target)
     {
-        SDL_LogError(
-            SDL_LOG_CATEGORY_APPLICATION,
-            "Scene Transition called with a scene that does not exist yet.");
-        return;
+        SDL_LogError(SDL_LOG_CATEGORY_RENDER,
+                     "Failed to create scene textures: %s", SDL_GetError());
+        return false;
     }
 
-    SceneTransition *trans = SDL_malloc(sizeof(SceneTransition));
-    *trans = transition;
+    // The canvas is the only texture that gets scaled, and it's pixel art.
+    SDL_SetTextureScaleMode(mgr->canvas, SDL_SCALEMODE_PIXELART);
+    SDL_SetTextureBlendMode(mgr->canvas, SDL_BLENDMODE_NONE);
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_VIDEO, "Resized scene textures to %dx%d", w,
+                h);
+    return true;
+}
+
+void scene_mgr_mark_dirty(SceneManager *mgr)
+{
+    mgr->dirty = true;
+}
 
-    trans->from_txt = SDL_CreateTexture(win.renderer, SDL_PIXELFORMAT_RGBA8888,
-                                        SDL_TEXTUREACCESS_TARGET, win.w, win.h);
-    trans->to_txt = SDL_CreateTexture(win.renderer, SDL_PIXELFORMAT_RGBA8888,
-                                      SDL_TEXTUREACCESS_TARGET, win.w, win.h);
+bool scene_mgr_needs_redraw(SceneManager *mgr)
+{
+    if (mgr->dirty)
+        return true;
 
-    if (!trans->from_txt || !trans->to_txt)
+    // Transitions animate every frame.
+    for (Uint32 i = 0; i < mgr->transitions.length; i++)
     {
-        SDL_Log("Failed to create transition textures: %s", SDL_GetError());
-        if (trans->from_txt)
-            SDL_DestroyTexture(trans->from_txt);
-        if (trans->to_txt)
-            SDL_DestroyTexture(trans->to_txt);
+        if (mgr->transitions.items[i].active)
+            return true;
+    }
 
-        SDL_free(trans);
-        return;
+    // Changes in hidden scenes don't matter.
+    for (int i = scene_mgr_first_visible(mgr); i < mgr->scenes->length; i++)
+    {
+        Scene *scene = mgr->scenes->items[i];
+        if (scene && scene->enabled && scene->dirty)
+            return true;
     }
 
-    SDL_SetTextureBlendMode(trans->from_txt, SDL_BLENDMODE_BLEND);
-    SDL_SetTextureBlendMode(trans->to_txt, SDL_BLENDMODE_BLEND);
+    return false;
+}
 
-    // Initialize the to transition.
-    if (transition.to_scene->oninit)
+/**
+ * Composes a transitioning scene into the canvas. Both sides of the transition
+ * are drawn offscreen, as they are moved around or faded as a whole.
+ */
+void scene_mgr_draw_transition(SceneManager *mgr, SceneTransition *trans)
+{
+    // We can add interpolation functions here after.
+    double progress = SDL_clamp(
+        trans->duration == 0 ? 1 : trans->elapsed / trans->duration, 0, 1);
+
+    // Depends on the transition type, we have to call each different
+    // transition handler.
+    switch (trans->type)
     {
-        transition.to_scene->oninit(transition.to_scene);
+    case TRANSITION_NONE:
+        scene_mgr_transition_render_none(mgr, trans, progress);
+        break;
+    case TRANSITION_FADE:
+        scene_mgr_transition_render_fade(mgr, trans, progress);
+        break;
+    case TRANSITION_SLIDE_LEFT:
+        scene_mgr_transition_render_slide_left(mgr, trans, progress);
+        break;
+    case TRANSITION_PUSH_UP:
+        scene_mgr_transition_render_push_up(mgr, trans, progress);
+        break;
+    case TRANSITION_PUSH_DOWN:
+        scene_mgr_transition_render_push_down(mgr, trans, progress);
+        break;
+    case TRANSITION_PUSH_LEFT:
+        scene_mgr_transition_render_push_left(mgr, trans, progress);
+        break;
+    case TRANSITION_PUSH_RIGHT:
+        scene_mgr_transition_render_push_right(mgr, trans, progress);
+        break;
     }
-    list_add(mgr->transitions, trans);
 }
 
 /**
- * Retrieves the active transition for the scene. This is definitely a slow
- * operation since it's doing this for every single scene. But if there are
- * maximum like 5 scenes at play, and therefore 5 transitions max, it's 25
- * pointer checks per frame, which is negligible compared to loading textures.
+ * Composes a scene into the current layer, which is the canvas, or the frozen
+ * snapshot. Fully opaque scenes draw straight into the layer. Only scenes with
+ * group alpha go through the offscreen target, so their own overlapping draws
+ * don't show through each other.
  */
-SceneTransition *scene_get_active_transition(SceneManager *mgr, Scene *scene)
+void scene_mgr_draw_scene(SceneManager *mgr, Scene *scene,
+                          SDL_Renderer *renderer)
 {
-    for (int i = 0; i < (int)mgr->transitions->length; i++)
+    if (!scene->ondraw)
+        return;
+
+    if (scene->opacity >= 1)
     {
-        SceneTransition *trans = (SceneTransition *)mgr->transitions->items[i];
-        if (trans->active && trans->from_scene == scene)
-            return trans;
+        scene->ondraw(scene, renderer);
+        return;
     }
 
-    return NULL;
+    SDL_Texture *layer = SDL_GetRenderTarget(renderer);
+    SDL_SetRenderTarget(renderer, mgr->target);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 0);
+    SDL_RenderClear(renderer);
+    scene->ondraw(scene, renderer);
+
+    SDL_SetRenderTarget(renderer, layer);
+    SDL_SetTextureAlphaModFloat(mgr->target, scene->opacity);
+    SDL_RenderTexture(renderer, mgr->target, NULL, NULL);
+    SDL_SetTextureAlphaModFloat(mgr->target, 1);
 }
 
-void scene_mgr_draw(SceneManager *mgr)
+/**
+ * Clears the current render target, unless the scene at index `first` covers
+ * it already.
+ */
+void scene_mgr_clear_layer(SceneManager *mgr, SDL_Renderer *renderer,
+                           int first)
 {
-    AppState *appstate = app_get();
-    SDL_Renderer *renderer = appstate->window.renderer;
+    Scene *bottom =
+        first < mgr->scenes->length ? mgr->scenes->items[first] : NULL;
+    if (!bottom || !bottom->enabled || !bottom->opaque ||
+        bottom->opacity < 1 || scene_get_active_transition(mgr, bottom))
+    {
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderClear(renderer);
+    }
+}
 
-    // We're gonna go through each scene in the current active stack and render
-    // them.
-    for (int i = 0; i < mgr->scenes->length; i++)
+/**
+ * Draws the scenes from index `first` up to `last` excluded into the current
+ * render target.
+ */
+void scene_mgr_draw_range(SceneManager *mgr, SDL_Renderer *renderer,
+                          int first, int last)
+{
+    for (int i = first; i < last; i++)
     {
         Scene *scene = mgr->scenes->items[i];
 
-        // Reset the renderer before starting
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 0);
-        SDL_SetRenderTarget(renderer, mgr->target);
-        SDL_RenderClear(renderer);
-
         // If a scene is not enabled, we don't render them anyway.
         if (!scene || !scene->enabled)
             continue;
 
-        // If a scene is within a transition, we ignore their draws.
+        // If a scene is within a transition, the transition draws it.
         SceneTransition *trans = scene_get_active_transition(mgr, scene);
         if (trans != NULL)
+            scene_mgr_draw_transition(mgr, trans);
+        else
+            scene_mgr_draw_scene(mgr, scene, renderer);
+        scene->dirty = false;
+    }
+}
+
+/**
+ * Finds the index of the scene that captures focus, if the scenes between
+ * `first` and it are paused and can be frozen into one snapshot. Returns -1
+ * if there is nothing to freeze.
+ */
+int scene_mgr_frozen_end(SceneManager *mgr, int first)
+{
+    int focus = -1;
+    for (int i = mgr->scenes->length - 1; i > first; i--)
+    {
+        Scene *scene = mgr->scenes->items[i];
+        if (scene && scene->captures_focus)
         {
-            // Make sure these are rendered.
-            // We can add interpolation functions here after.
-            double progress = SDL_clamp(
-                trans->duration == 0 ? 1 : trans->elapsed / trans->duration, 0,
-                1);
-
-            // Clear up transitioning targets also.
-            SDL_SetRenderTarget(renderer, trans->from_txt);
-            SDL_RenderClear(renderer);
-            SDL_SetRenderTarget(renderer, trans->to_txt);
-            SDL_RenderClear(renderer);
-            SDL_SetRenderTarget(renderer, mgr->target);
-
-            // Depends on the transition type, we have to call each different
-            // transition handler.
-            switch (trans->type)
-            {
-            case TRANSITION_NONE:
-                scene_mgr_transition_render_none(mgr, trans, progress);
-                break;
-            case TRANSITION_FADE:
-                scene_mgr_transition_render_fade(mgr, trans, progress);
-                break;
-            case TRANSITION_SLIDE_LEFT:
-                scene_mgr_transition_render_slide_left(mgr, trans, progress);
-                break;
-            case TRANSITION_PUSH_UP:
-                scene_mgr_transition_render_push_up(mgr, trans, progress);
-                break;
-            case TRANSITION_PUSH_DOWN:
-                scene_mgr_transition_render_push_down(mgr, trans, progress);
-                break;
-            case TRANSITION_PUSH_LEFT:
-                scene_mgr_transition_render_push_left(mgr, trans, progress);
-                break;
-            case TRANSITION_PUSH_RIGHT:
-                scene_mgr_transition_render_push_right(mgr, trans, progress);
-                break;
-            }
+            focus = i;
+            break;
+        }
+    }
 
-            // Apply and clear for next frame.
-            SDL_SetRenderTarget(renderer, NULL);
-            SDL_RenderTexture(renderer, mgr->target, NULL, NULL);
+    // Paused scenes in a transition still animate, so they can't be frozen.
+    for (int i = first; i < focus; i++)
+    {
+        Scene *scene = mgr->scenes->items[i];
+        if (scene && scene_get_active_transition(mgr, scene))
+            return -1;
+    }
 
-            continue;
-        }
+    return focus;
+}
+
+void scene_mgr_draw(SceneManager *mgr)
+{
+    AppState *appstate = app_get();
+    SDL_Renderer *renderer = appstate->window.renderer;
+    WindowStatus win = appstate->window;
+    bool stack_changed = mgr->dirty;
+    mgr->dirty = false;
 
-        // Otherwise, we let it draw normally.
-        if (scene->ondraw)
+    // Everything below an opaque scene is hidden, so we start from there.
+    int first = scene_mgr_first_visible(mgr);
+    int frozen = scene_mgr_frozen_end(mgr, first);
+
+    // Nothing is paused, everything is drawn straight into the canvas.
+    if (frozen < 0)
+    {
+        target_pool_release(mgr->targets, mgr->snapshot);
+        mgr->snapshot = NULL;
+
+        SDL_SetRenderTarget(renderer, mgr->canvas);
+        scene_mgr_clear_layer(mgr, renderer, first);
+        scene_mgr_draw_range(mgr, renderer, first, mgr->scenes->length);
+        return;
+    }
+
+    // The scenes below the focus can't tick, so they look the same until the
+    // stack changes or one of them is marked dirty. We keep them drawn in a
+    // snapshot, which costs one blit per frame instead of redrawing them.
+    bool recapture = stack_changed || mgr->snapshot == NULL ||
+                     mgr->snapshot_focus != mgr->scenes->items[frozen];
+    for (int i = first; i < frozen && !recapture; i++)
+    {
+        Scene *scene = mgr->scenes->items[i];
+        recapture = scene && scene->enabled && scene->dirty;
+    }
+
+    if (recapture)
+    {
+        if (!mgr->snapshot)
         {
-            scene->ondraw(scene, renderer);
+            mgr->snapshot =
+                target_pool_acquire(mgr->targets, win.logical_w,
+                                    win.logical_h, SDL_PIXELFORMAT_RGBA8888);
+        }
 
-            // Draw on the scene and reset.
-            SDL_SetRenderTarget(renderer, NULL);
-            SDL_RenderTexture(renderer, mgr->target, NULL, NULL);
+        // Couldn't get a texture, so we just draw everything.
+        if (!mgr->snapshot)
+        {
+            SDL_SetRenderTarget(renderer, mgr->canvas);
+            scene_mgr_clear_layer(mgr, renderer, first);
+            scene_mgr_draw_range(mgr, renderer, first, mgr->scenes->length);
+            return;
         }
+
+        SDL_SetTextureBlendMode(mgr->snapshot, SDL_BLENDMODE_NONE);
+        SDL_SetRenderTarget(renderer, mgr->snapshot);
+        scene_mgr_clear_layer(mgr, renderer, first);
+        scene_mgr_draw_range(mgr, renderer, first, frozen);
+        mgr->snapshot_focus = mgr->scenes->items[frozen];
     }
+
+    // The snapshot is a whole opaque frame, so it replaces clearing the
+    // canvas. Then the scenes from the focus up are drawn live on top.
+    SDL_SetRenderTarget(renderer, mgr->canvas);
+    SDL_RenderTexture(renderer, mgr->snapshot, NULL, NULL);
+    scene_mgr_draw_range(mgr, renderer, frozen, mgr->scenes->length);
 }
 
 bool scene_mgr_push_scene(SceneManager *mgr, Scene *scene)
 {
     if (stack_push(mgr->scenes, scene))
     {
+        if (!scene_acquire_assets(scene))
+        {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Unable to load the assets of scene %d", scene->id);
+            stack_pop(mgr->scenes);
+            scene_destroy(scene);
+            return false;
+        }
+
+        mgr->dirty = true;
         if (scene->oninit)
             scene->oninit(scene);
         if (scene->onstart)
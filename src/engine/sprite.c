@@ -7,14 +7,59 @@
 #include "SDL3/SDL_surface.h"
 #include "SDL3_image/SDL_image.h"
 #include "app.h"
+#include "engine/assets.h"
+#include "engine/pack.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// The fixed sizes of the version 2 header and records, in bytes.
+#define SPRITE_V2_HEADER_SIZE 40
+#define SPRITE_V2_FRAME_SIZE 44
+#define SPRITE_V2_TAG_SIZE 16
+
+/**
+ * Precomputes the durations in seconds, so animating doesn't have to divide.
+ * A frame lasts at least a millisecond, so stepping through frames always
+ * moves forward.
+ */
+void sprite_sheet_compute_secs(SpriteSheet *sheet)
+{
+    sheet->secs = 0;
+    sheet->frame_secs = NULL;
+    if (sheet->num_frames > 0)
+        sheet->frame_secs = SDL_malloc(sizeof(float) * sheet->num_frames);
+
+    for (Uint32 i = 0; i < sheet->num_frames; i++)
+    {
+        Uint32 ms = SDL_max(sheet->frames[i].duration, 1);
+        sheet->frame_secs[i] = ms / 1000.0f;
+        sheet->secs += sheet->frame_secs[i];
+    }
+
+    for (Uint32 i = 0; i < sheet->num_tags; i++)
+    {
+        FrameTag *tag = &sheet->tags[i];
+        tag->secs = 0;
+
+        // Drop tags that point outside of the frames.
+        if (tag->from > tag->to || tag->to >= sheet->num_frames)
+        {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                        "Frame tag %s is out of bounds", tag->tag);
+            tag->from = tag->to = 0;
+            continue;
+        }
+
+        for (Uint32 j = tag->from; j <= tag->to; j++)
+            tag->secs += sheet->frame_secs[j];
+    }
+}
+
 /**
  * Version 1 of the sprite decoder tool.
  */
-void sprite_init_v1(SDL_IOStream *io, Sprite **spr)
+void sprite_init_v1(SDL_IOStream *io, SpriteSheet **out)
 {
     // First let's read the image first.
     // We start with the image length and then all the bytes of the image.
@@ -56,6 +101,7 @@ void sprite_init_v1(SDL_IOStream *io, Sprite **spr)
 
             SDL_ReadU32LE(io, &tags[i].from);
             SDL_ReadU32LE(io, &tags[i].to);
+            tags[i].secs = 0;
         }
     }
     else
@@ -110,31 +156,164 @@ void sprite_init_v1(SDL_IOStream *io, Sprite **spr)
     }
 
     // Only allocate when we're sure everything is ready.
-    Sprite *sprite = SDL_malloc(sizeof(Sprite));
-    sprite->tags = tags;
-    sprite->num_tags = num_tags;
-    sprite->size.x = width;
-    sprite->size.y = height;
-    sprite->frames = frames;
-    sprite->num_frames = num_frames;
-    sprite->playing = false;
-    sprite->frame_idx = 0;
-    sprite->frame_accum = 0;
-    sprite->sel_tag = -1;
-
-    // Load the texture needed.
+    SpriteSheet *sheet = SDL_malloc(sizeof(SpriteSheet));
+    sheet->tags = tags;
+    sheet->num_tags = num_tags;
+    sheet->size.x = width;
+    sheet->size.y = height;
+    sheet->frames = frames;
+    sheet->num_frames = num_frames;
+    sheet->refs = 1;
+    sheet->texture = NULL;
+    sheet->uploaded_rows = 0;
+    sprite_sheet_compute_secs(sheet);
+
+    // Decode the image, in the format the texture is uploaded with.
     SDL_IOStream *img_io = SDL_IOFromMem(img_data, img_len);
     SDL_Surface *surface = IMG_Load_IO(img_io, true);
-    SDL_Texture *texture =
-        SDL_CreateTextureFromSurface(app_get()->window.renderer, surface);
-    sprite->texture = texture;
+    sheet->pending = NULL;
+    if (surface)
+    {
+        sheet->pending = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+        SDL_DestroySurface(surface);
+    }
 
-    SDL_DestroySurface(surface);
     SDL_free(img_data);
-    *spr = sprite;
+    *out = sheet;
 }
 
-Sprite *sprite_init(const char *sprite)
+/**
+ * Destroys a sprite sheet and everything it holds.
+ */
+void sprite_sheet_destroy(SpriteSheet *sheet)
+{
+    if (sheet->tags)
+    {
+        for (Uint32 i = 0; i < sheet->num_tags; i++)
+        {
+            SDL_free(sheet->tags[i].tag);
+        }
+        SDL_free(sheet->tags);
+    }
+
+    SDL_free(sheet->frames);
+    SDL_free(sheet->frame_secs);
+    SDL_DestroySurface(sheet->pending);
+    SDL_DestroyTexture(sheet->texture);
+    SDL_free(sheet);
+}
+
+/**
+ * Reads a little endian u32 from a buffer that may not be aligned.
+ */
+Uint32 sprite_read_u32(const Uint8 *data)
+{
+    Uint32 value;
+    SDL_memcpy(&value, data, sizeof(value));
+    return SDL_Swap32LE(value);
+}
+
+/**
+ * Version 2 of the sprite decoder tool. The whole file is already in memory.
+ * The frame and tag tables have a fixed layout, so they are read in place,
+ * and the pixels are uploaded to the texture as they are, without decoding.
+ * The pending pixels point into the file's memory.
+ */
+void sprite_init_v2(const Uint8 *data, size_t size, SpriteSheet **out)
+{
+    if (size < SPRITE_V2_HEADER_SIZE)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Sprite header is cut off");
+        return;
+    }
+
+    // The header, after the version: width, height, pitch, number of frames,
+    // number of tags, and the offsets of the frames, the tags, the tag names
+    // and the pixels.
+    Uint32 width = sprite_read_u32(data + 4);
+    Uint32 height = sprite_read_u32(data + 8);
+    Uint32 pitch = sprite_read_u32(data + 12);
+    Uint32 num_frames = sprite_read_u32(data + 16);
+    Uint32 num_tags = sprite_read_u32(data + 20);
+    Uint32 frames_at = sprite_read_u32(data + 24);
+    Uint32 tags_at = sprite_read_u32(data + 28);
+    Uint32 names_at = sprite_read_u32(data + 32);
+    Uint32 pixels_at = sprite_read_u32(data + 36);
+
+    // Make sure every table fits in the file before touching any of them.
+    Uint64 frames_end =
+        (Uint64)frames_at + (Uint64)num_frames * SPRITE_V2_FRAME_SIZE;
+    Uint64 tags_end = (Uint64)tags_at + (Uint64)num_tags * SPRITE_V2_TAG_SIZE;
+    Uint64 pixels_end = (Uint64)pixels_at + (Uint64)pitch * height;
+    if (frames_end > size || tags_end > size || names_at > size ||
+        pixels_end > size || pitch < (Uint64)width * 4)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Sprite tables are out of bounds");
+        return;
+    }
+
+    FrameTag *tags = NULL;
+    if (num_tags > 0)
+        tags = SDL_malloc(sizeof(FrameTag) * num_tags);
+
+    for (Uint32 i = 0; i < num_tags; i++)
+    {
+        // Each tag is its name's offset in the names and its length, then the
+        // "from" and "to" frames.
+        const Uint8 *rec = data + tags_at + i * SPRITE_V2_TAG_SIZE;
+        Uint64 name_at = (Uint64)names_at + sprite_read_u32(rec);
+        Uint32 name_len = sprite_read_u32(rec + 4);
+        if (name_at + name_len > size)
+            name_len = 0;
+
+        tags[i].tag = SDL_strndup((const char *)data + name_at, name_len);
+        tags[i].from = sprite_read_u32(rec + 8);
+        tags[i].to = sprite_read_u32(rec + 12);
+        tags[i].secs = 0;
+    }
+
+    SpriteFrame *frames = NULL;
+    if (num_frames > 0)
+        frames = SDL_malloc(sizeof(SpriteFrame) * num_frames);
+
+    for (Uint32 i = 0; i < num_frames; i++)
+    {
+        // Same fields as version 1, in the same order.
+        const Uint8 *rec = data + frames_at + i * SPRITE_V2_FRAME_SIZE;
+        frames[i].size.x = sprite_read_u32(rec);
+        frames[i].size.y = sprite_read_u32(rec + 4);
+        frames[i].offset.x = (float)sprite_read_u32(rec + 8);
+        frames[i].offset.y = (float)sprite_read_u32(rec + 12);
+        frames[i].offset.w = (float)sprite_read_u32(rec + 16);
+        frames[i].offset.h = (float)sprite_read_u32(rec + 20);
+        frames[i].frame.x = (float)sprite_read_u32(rec + 24);
+        frames[i].frame.y = (float)sprite_read_u32(rec + 28);
+        frames[i].frame.w = (float)sprite_read_u32(rec + 32);
+        frames[i].frame.h = (float)sprite_read_u32(rec + 36);
+        frames[i].duration = sprite_read_u32(rec + 40);
+    }
+
+    SpriteSheet *sheet = SDL_malloc(sizeof(SpriteSheet));
+    sheet->texture = NULL;
+    sheet->uploaded_rows = 0;
+
+    // The pixels are RGBA32 already, the texture takes them as they are.
+    sheet->pending =
+        SDL_CreateSurfaceFrom((int)width, (int)height, SDL_PIXELFORMAT_RGBA32,
+                              (void *)(data + pixels_at), (int)pitch);
+    sheet->tags = tags;
+    sheet->num_tags = num_tags;
+    sheet->size.x = width;
+    sheet->size.y = height;
+    sheet->frames = frames;
+    sheet->num_frames = num_frames;
+    sheet->refs = 1;
+    sprite_sheet_compute_secs(sheet);
+    *out = sheet;
+}
+
+SpriteSheet *sprite_sheet_init(const char *sprite)
 {
     SDL_Log("Attempting to load sprite %s", sprite);
 
@@ -142,25 +321,57 @@ Sprite *sprite_init(const char *sprite)
     SDL_strlcat(buf, sprite, sizeof(buf));
     SDL_strlcat(buf, ".sprite", sizeof(buf));
 
-    SDL_IOStream *io = SDL_IOFromFile(buf, "r");
-    Sprite *spr = NULL;
-
-    if (io == NULL)
+    // Read the whole file at once, then decode it from memory. Files in the
+    // asset pack are decoded in place.
+    size_t size = 0;
+    bool owned = false;
+    void *data = pack_read(buf, &size, &owned);
+    if (data == NULL)
     {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't load sprite %s",
                      buf);
         return NULL;
     }
 
-    // Ok we can now create the Sprite *. Hopefully it's not the wrong file
-    // type!
-    Uint32 version;
-    SDL_ReadU32LE(io, &version);
+    SpriteSheet *sheet = sprite_sheet_decode(data, size);
+    if (owned)
+        SDL_free(data);
+    return sheet;
+}
+
+SpriteSheet *sprite_sheet_decode(const void *data, size_t size)
+{
+    SpriteSheet *sheet = sprite_sheet_parse(data, size);
+    if (sheet)
+        sprite_sheet_upload(sheet, app_get()->window.renderer, 0);
+    return sheet;
+}
+
+SpriteSheet *sprite_sheet_parse(const void *data, size_t size)
+{
+    SpriteSheet *sheet = NULL;
+    if (size < sizeof(Uint32))
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Sprite file is empty");
+        return NULL;
+    }
+
+    // Ok we can now create the SpriteSheet *. Hopefully it's not the wrong
+    // file type!
+    Uint32 version = sprite_read_u32(data);
 
     switch (version)
     {
     case 1:
-        sprite_init_v1(io, &spr);
+    {
+        SDL_IOStream *io = SDL_IOFromConstMem(data, size);
+        SDL_SeekIO(io, sizeof(Uint32), SDL_IO_SEEK_SET);
+        sprite_init_v1(io, &sheet);
+        SDL_CloseIO(io);
+        break;
+    }
+    case 2:
+        sprite_init_v2(data, size, &sheet);
         break;
     default:
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -168,80 +379,218 @@ Sprite *sprite_init(const char *sprite)
         break;
     }
 
-    SDL_SetTextureScaleMode(spr->texture, SDL_SCALEMODE_PIXELART);
-    SDL_CloseIO(io);
-    return spr;
+    return sheet;
 }
 
-bool sprite_set_animation(Sprite *spr, const char *name)
+bool sprite_sheet_upload(SpriteSheet *sheet, SDL_Renderer *renderer,
+                         int max_rows)
 {
-    if (name == NULL)
-    {
-        spr->sel_tag = -1;
-        return false;
-    }
+    SDL_Surface *pending = sheet->pending;
+    if (!pending)
+        return true;
 
-    int idx = -1;
-    for (Uint32 i = 0; i < spr->num_tags; i++)
+    if (!sheet->texture)
     {
-        if (SDL_strcmp(spr->tags[i].tag, name) == 0)
+        sheet->texture =
+            SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                              SDL_TEXTUREACCESS_STATIC, pending->w, pending->h);
+        if (!sheet->texture)
         {
-            idx = (int)i;
-            break;
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Unable to create sprite texture. %s", SDL_GetError());
+            SDL_DestroySurface(pending);
+            sheet->pending = NULL;
+            return true;
         }
-    }
 
-    spr->sel_tag = idx;
-    if (idx < 0)
-    {
-        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                    "Trying to set sprite's animation to %s failed.", name);
+        SDL_SetTextureBlendMode(sheet->texture, SDL_BLENDMODE_BLEND);
+        SDL_SetTextureScaleMode(sheet->texture, SDL_SCALEMODE_PIXELART);
     }
-    else
+
+    int rows = pending->h - sheet->uploaded_rows;
+    if (max_rows > 0)
+        rows = SDL_min(rows, max_rows);
+
+    SDL_Rect rect = {
+        .x = 0,
+        .y = sheet->uploaded_rows,
+        .w = pending->w,
+        .h = rows,
+    };
+    const Uint8 *pixels = pending->pixels;
+    SDL_UpdateTexture(sheet->texture, &rect,
+                      pixels + (size_t)rect.y * pending->pitch, pending->pitch);
+    sheet->uploaded_rows += rows;
+
+    if (sheet->uploaded_rows < pending->h)
+        return false;
+
+    SDL_DestroySurface(pending);
+    sheet->pending = NULL;
+    return true;
+}
+
+SpriteSheet *sprite_sheet_ref(SpriteSheet *sheet)
+{
+    if (sheet)
+        sheet->refs++;
+    return sheet;
+}
+
+void sprite_sheet_release(SpriteSheet *sheet)
+{
+    if (!sheet)
+        return;
+
+    if (--sheet->refs == 0)
+        sprite_sheet_destroy(sheet);
+}
+
+int sprite_sheet_find_tag(const SpriteSheet *sheet, const char *name)
+{
+    if (name == NULL)
+        return -1;
+
+    for (Uint32 i = 0; i < sheet->num_tags; i++)
     {
-        sprite_reset_animation(spr);
+        if (SDL_strcmp(sheet->tags[i].tag, name) == 0)
+            return (int)i;
     }
 
-    return idx >= 0;
+    return -1;
 }
 
-void sprite_reset_animation(Sprite *spr)
+Uint32 sprite_sheet_tag_length(const SpriteSheet *sheet, int tag)
 {
-    spr->frame_idx = 0;
-    spr->frame_accum = 0;
-    spr->playing = false;
+    if (tag < 0)
+        return sheet->num_frames;
+
+    FrameTag *t = &sheet->tags[tag];
+    return t->to - t->from + 1;
 }
 
-bool sprite_advance_animation(Sprite *spr, double dt)
+const SpriteFrame *sprite_sheet_frame(const SpriteSheet *sheet, int tag,
+                                      Uint32 idx)
 {
-    spr->frame_accum += dt;
+    if (tag >= 0)
+        idx += sheet->tags[tag].from;
+    return &sheet->frames[idx];
+}
+
+bool sprite_frames_step(const float *secs, Uint32 length, float loop_secs,
+                        Uint32 *frame, float *accum)
+{
+    Uint32 start = *frame;
+    float acc = *accum;
 
-    // Get the current frame and see if we passed the threshold.
-    SpriteFrame *current = NULL;
-    Uint32 total;
+    // Full loops end on the same frame, skip them all at once.
+    if (loop_secs > 0 && acc >= loop_secs)
+        acc = SDL_fmodf(acc, loop_secs);
 
-    if (spr->sel_tag >= 0)
+    Uint32 cur = start;
+    while (acc >= secs[cur])
     {
-        FrameTag tag = spr->tags[spr->sel_tag];
-        total = tag.to - tag.from + 1;
-        current = &spr->frames[tag.from + spr->frame_idx];
+        acc -= secs[cur];
+        cur = cur + 1 == length ? 0 : cur + 1;
     }
-    else
+
+    *frame = cur;
+    *accum = acc;
+    return cur != start;
+}
+
+void sprite_animator_set_tag(SpriteAnimator *anim, int tag)
+{
+    anim->tag = tag;
+    sprite_animator_reset(anim);
+}
+
+void sprite_animator_reset(SpriteAnimator *anim)
+{
+    anim->frame_idx = 0;
+    anim->frame_accum = 0;
+    anim->playing = false;
+}
+
+bool sprite_animator_advance(SpriteAnimator *anim, const SpriteSheet *sheet,
+                             double dt)
+{
+    if (!anim->playing)
+        return false;
+
+    Uint32 total = sprite_sheet_tag_length(sheet, anim->tag);
+    if (total == 0)
+        return false;
+
+    const float *secs = sheet->frame_secs;
+    float loop_secs = sheet->secs;
+    if (anim->tag >= 0)
     {
-        total = spr->num_frames;
-        current = &spr->frames[spr->frame_idx];
+        secs += sheet->tags[anim->tag].from;
+        loop_secs = sheet->tags[anim->tag].secs;
     }
 
-    // Check if we passed the sprite frame's duration threshold.
-    // If so, we advance the index by one.
-    if (current && spr->frame_accum > (current->duration / 1000.0))
+    anim->frame_accum += (float)dt;
+    return sprite_frames_step(secs, total, loop_secs, &anim->frame_idx,
+                              &anim->frame_accum);
+}
+
+Sprite *sprite_init(const char *sprite)
+{
+    SpriteSheet *sheet = assets_acquire_sprite(sprite);
+    if (!sheet)
+        return NULL;
+
+    // The sprite keeps the asset until it's destroyed, so sprites of the same
+    // asset share its sheet.
+    Sprite *spr = sprite_init_shared(sheet);
+    spr->asset = SDL_strdup(sprite);
+    return spr;
+}
+
+Sprite *sprite_init_shared(SpriteSheet *sheet)
+{
+    if (!sheet)
+        return NULL;
+
+    Sprite *spr = SDL_malloc(sizeof(Sprite));
+    spr->sheet = sprite_sheet_ref(sheet);
+    spr->asset = NULL;
+    spr->anim.tag = -1;
+    sprite_animator_reset(&spr->anim);
+    return spr;
+}
+
+bool sprite_set_animation(Sprite *spr, const char *name)
+{
+    int idx = sprite_sheet_find_tag(spr->sheet, name);
+    if (idx < 0 && name != NULL)
     {
-        spr->frame_accum -= (current->duration / 1000.0);
-        spr->frame_idx = (spr->frame_idx + 1) % total;
-        return true;
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Trying to set sprite's animation to %s failed.", name);
     }
 
-    return false;
+    if (idx < 0)
+        spr->anim.tag = -1;
+    else
+        sprite_animator_set_tag(&spr->anim, idx);
+
+    return idx >= 0;
+}
+
+void sprite_reset_animation(Sprite *spr)
+{
+    sprite_animator_reset(&spr->anim);
+}
+
+bool sprite_advance_animation(Sprite *spr, double dt)
+{
+    return sprite_animator_advance(&spr->anim, spr->sheet, dt);
+}
+
+const SpriteFrame *sprite_current_frame(const Sprite *spr)
+{
+    return sprite_sheet_frame(spr->sheet, spr->anim.tag, spr->anim.frame_idx);
 }
 
 void sprite_destroy(Sprite *spr)
@@ -249,16 +598,11 @@ void sprite_destroy(Sprite *spr)
     if (!spr)
         return;
 
-    if (spr->tags)
+    sprite_sheet_release(spr->sheet);
+    if (spr->asset)
     {
-        for (Uint32 i = 0; i < spr->num_tags; i++)
-        {
-            SDL_free(spr->tags[i].tag);
-        }
-        SDL_free(spr->tags);
+        assets_release(ASSET_TYPE_SPRITE, spr->asset);
+        SDL_free(spr->asset);
     }
-
-    SDL_free(spr->frames);
-    SDL_DestroyTexture(spr->texture);
     SDL_free(spr);
 }
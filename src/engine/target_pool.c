@@ -0,0 +1,142 @@
+#include "engine/target_pool.h"
+#include "SDL3/SDL_blendmode.h"
+#include "SDL3/SDL_error.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_render.h"
+#include "SDL3/SDL_stdinc.h"
+#include "misc/list.h"
+
+RenderTargetPool *target_pool_init(SDL_Renderer *renderer)
+{
+    RenderTargetPool *pool = SDL_malloc(sizeof(RenderTargetPool));
+    pool->renderer = renderer;
+    pool->targets = list_init();
+    pool->w = 0;
+    pool->h = 0;
+    return pool;
+}
+
+/**
+ * Puts a texture back to a clean state, since the last borrower may have
+ * changed its modulation.
+ */
+void target_pool_reset_texture(SDL_Texture *texture)
+{
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureAlphaModFloat(texture, 1);
+    SDL_SetTextureColorMod(texture, 255, 255, 255);
+}
+
+SDL_Texture *target_pool_acquire(RenderTargetPool *pool, int w, int h,
+                                 SDL_PixelFormat format)
+{
+    for (Uint32 i = 0; i < pool->targets->length; i++)
+    {
+        PooledTarget *target = pool->targets->items[i];
+        if (!target->in_use && target->w == w && target->h == h &&
+            target->format == format)
+        {
+            target->in_use = true;
+            target_pool_reset_texture(target->texture);
+            return target->texture;
+        }
+    }
+
+    // Nothing free fits, so we have to create one.
+    SDL_Texture *texture = SDL_CreateTexture(pool->renderer, format,
+                                             SDL_TEXTUREACCESS_TARGET, w, h);
+    if (!texture)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_RENDER,
+                     "Failed to create a pooled render target. %s",
+                     SDL_GetError());
+        return NULL;
+    }
+    target_pool_reset_texture(texture);
+
+    PooledTarget *target = SDL_malloc(sizeof(PooledTarget));
+    target->texture = texture;
+    target->w = w;
+    target->h = h;
+    target->format = format;
+    target->in_use = true;
+    list_add(pool->targets, target);
+
+    SDL_LogDebug(SDL_LOG_CATEGORY_RENDER, "Pooled a new %dx%d render target",
+                 w, h);
+    return texture;
+}
+
+void target_pool_release(RenderTargetPool *pool, SDL_Texture *texture)
+{
+    if (!texture)
+        return;
+
+    for (Uint32 i = 0; i < pool->targets->length; i++)
+    {
+        PooledTarget *target = pool->targets->items[i];
+        if (target->texture != texture)
+            continue;
+
+        // Borrowed before a resize, nobody is going to ask for it again.
+        if (target->w != pool->w || target->h != pool->h)
+        {
+            list_remove_at(pool->targets, i);
+            SDL_DestroyTexture(target->texture);
+            SDL_free(target);
+        }
+        else
+        {
+            target->in_use = false;
+        }
+        return;
+    }
+
+    SDL_LogWarn(SDL_LOG_CATEGORY_RENDER,
+                "Released a render target that isn't from the pool.");
+}
+
+bool target_pool_resize(RenderTargetPool *pool, int w, int h)
+{
+    if (pool->w == w && pool->h == h)
+        return false;
+
+    pool->w = w;
+    pool->h = h;
+
+    // Drop the free targets of the old size. Borrowed ones are dropped when
+    // they're released.
+    Uint32 i = 0;
+    while (i < pool->targets->length)
+    {
+        PooledTarget *target = pool->targets->items[i];
+        if (!target->in_use && (target->w != w || target->h != h))
+        {
+            list_remove_at(pool->targets, i);
+            SDL_DestroyTexture(target->texture);
+            SDL_free(target);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    return true;
+}
+
+void target_pool_destroy(RenderTargetPool *pool)
+{
+    if (!pool)
+        return;
+
+    for (Uint32 i = 0; i < pool->targets->length; i++)
+    {
+        PooledTarget *target = pool->targets->items[i];
+        SDL_DestroyTexture(target->texture);
+        SDL_free(target);
+    }
+    list_destroy(pool->targets);
+    SDL_free(pool);
+}
@@ -8,10 +8,50 @@
 #include "SDL3_ttf/SDL_ttf.h"
 #include "app.h"
 #include "engine/renderer.h"
+#include "engine/pack.h"
+#include "misc/hashmap.h"
 #include "misc/mathex.h"
 
 #define MAX_FONT_NODES 50
 
+// How many opened fonts are kept around. Past this, the least recently used
+// ones that no label holds on to get closed.
+#define MAX_CACHED_FONTS 16
+
+#define GLYPH_ATLAS_SIZE 512
+#define GLYPH_ATLAS_PADDING 1
+#define GLYPH_ASCII_COUNT 128
+
+/**
+ * Represents a glyph that was rasterized into an atlas.
+ */
+typedef struct
+{
+    SDL_FRect src; // The glyph's rectangle within the atlas. Empty for
+                   // glyphs that draw nothing, like spaces.
+    int advance;   // How far the pen moves after drawing this glyph.
+    bool cached;   // Whether the glyph was rasterized yet.
+} Glyph;
+
+/**
+ * Represents a texture that holds every glyph a font has drawn so far. Glyphs
+ * are packed into rows (shelves), from the top left.
+ */
+typedef struct
+{
+    SDL_Texture *texture;
+    int pen_x, pen_y;  // Where the next glyph goes on the current shelf.
+    int shelf_h;       // The tallest glyph on the current shelf.
+    Uint32 generation; // Bumped each time the atlas is full and flushed.
+
+    Glyph ascii[GLYPH_ASCII_COUNT]; // Direct lookup for the common glyphs.
+    HashMap *others; // Every other glyph by codepoint, as an index + 1 into
+                     // `extra`, since NULL means missing.
+    Glyph *extra;
+    Uint32 num_extra;
+    Uint32 cap_extra;
+} GlyphAtlas;
+
 /**
  * Represents a node present within a map to cache fonts.
  */
@@ -19,15 +59,50 @@ typedef struct FontNode
 {
     Font font;
     TTF_Font *ttf_font;
+    GlyphAtlas *atlas; // Created the first time the font draws something.
+    Uint32 refs;       // How many labels use the font. Pinned if not 0.
     struct FontNode *next;
+
+    // The recently used list, from the most recent to the least recent.
+    struct FontNode *lru_prev;
+    struct FontNode *lru_next;
 } FontNode;
 
+/**
+ * Represents a font file read into memory. Every size and style of a face is
+ * opened from the same buffer.
+ */
+typedef struct
+{
+    void *data;
+    size_t size;
+    bool owned; // Whether the data was read, or lives in the asset pack.
+} FontFile;
+
 // The map we're using as a bucket map for font nodes.
 static FontNode *font_nodes[MAX_FONT_NODES] = {0};
 
+// The recently used list of every font node, and how many there are.
+static FontNode *font_lru_head = NULL;
+static FontNode *font_lru_tail = NULL;
+static Uint32 num_cached_fonts = 0;
+
+// The font files, by face.
+static FontFile font_files[NUM_FONT_FACES] = {0};
+
+// The fonts that are opened when the engine starts.
+static const Font preloaded_fonts[] = {
+    {.face = FONT_FACE_DAYDREAM, .sp = 12, .style = TTF_STYLE_NORMAL},
+};
+
 // Other stuff from TTF to handle.
 static TTF_TextEngine *text_engine = NULL;
 
+// Scratch buffers to batch a string's quads, kept around between calls.
+static SDL_Vertex *text_vertices = NULL;
+static int *text_indices = NULL;
+static int text_quad_capacity = 0;
+
 const char *get_font_file_name(FontFace face)
 {
     switch (face)
@@ -43,13 +118,181 @@ const char *get_font_file_name(FontFace face)
     }
 }
 
-bool font_engine_init(AppState *app)
+/**
+ * Initializes an empty glyph atlas.
+ */
+GlyphAtlas *glyph_atlas_init(SDL_Renderer *renderer)
+{
+    SDL_Texture *texture =
+        SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                          SDL_TEXTUREACCESS_STATIC, GLYPH_ATLAS_SIZE,
+                          GLYPH_ATLAS_SIZE);
+    if (!texture)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_RENDER,
+                     "Unable to create a glyph atlas. %s", SDL_GetError());
+        return NULL;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_PIXELART);
+
+    GlyphAtlas *atlas = SDL_calloc(1, sizeof(GlyphAtlas));
+    atlas->texture = texture;
+    atlas->others = hash_map_init();
+    return atlas;
+}
+
+/**
+ * Forgets every glyph in the atlas, so the space can be reused.
+ */
+void glyph_atlas_flush(GlyphAtlas *atlas)
+{
+    SDL_memset(atlas->ascii, 0, sizeof(atlas->ascii));
+    hash_map_clear(atlas->others);
+    atlas->num_extra = 0;
+    atlas->pen_x = 0;
+    atlas->pen_y = 0;
+    atlas->shelf_h = 0;
+    atlas->generation++;
+}
+
+/**
+ * Finds a spot for a glyph of the provided size. This flushes the atlas if
+ * it's full. Returns false if the glyph is bigger than the atlas itself.
+ */
+bool glyph_atlas_pack(GlyphAtlas *atlas, int w, int h, SDL_Rect *rect)
 {
-    (void)app;
-    text_engine = TTF_CreateSurfaceTextEngine();
+    if (w + GLYPH_ATLAS_PADDING > GLYPH_ATLAS_SIZE ||
+        h + GLYPH_ATLAS_PADDING > GLYPH_ATLAS_SIZE)
+        return false;
+
+    // Doesn't fit on this shelf, start a new one below.
+    if (atlas->pen_x + w + GLYPH_ATLAS_PADDING > GLYPH_ATLAS_SIZE)
+    {
+        atlas->pen_x = 0;
+        atlas->pen_y += atlas->shelf_h;
+        atlas->shelf_h = 0;
+    }
+
+    // Doesn't fit anywhere, start over.
+    if (atlas->pen_y + h + GLYPH_ATLAS_PADDING > GLYPH_ATLAS_SIZE)
+    {
+        SDL_LogInfo(SDL_LOG_CATEGORY_RENDER, "Glyph atlas is full, flushing");
+        glyph_atlas_flush(atlas);
+    }
+
+    rect->x = atlas->pen_x;
+    rect->y = atlas->pen_y;
+    rect->w = w;
+    rect->h = h;
+    atlas->pen_x += w + GLYPH_ATLAS_PADDING;
+    atlas->shelf_h = SDL_max(atlas->shelf_h, h + GLYPH_ATLAS_PADDING);
     return true;
 }
 
+/**
+ * Rasterizes a glyph in white into the atlas. The color is applied when
+ * drawing, so one rasterization serves every color.
+ *
+ * Packing the glyph may flush the atlas, which wipes the ASCII glyphs. The
+ * glyph is filled in last, so it can be one of those.
+ */
+void glyph_atlas_rasterize(GlyphAtlas *atlas, TTF_Font *font, Uint32 ch,
+                           Glyph *glyph)
+{
+    Glyph out = {.cached = true};
+    TTF_GetGlyphMetrics(font, ch, NULL, NULL, NULL, NULL, &out.advance);
+
+    // A glyph rendered alone is laid out like a one letter string, so it can
+    // be placed at the pen directly.
+    SDL_Color white = {.r = 255, .g = 255, .b = 255, .a = 255};
+    SDL_Surface *surface = TTF_RenderGlyph_Solid(font, ch, white);
+    if (!surface)
+    {
+        *glyph = out; // Nothing to draw, like a space.
+        return;
+    }
+
+    SDL_Rect rect;
+    if (!glyph_atlas_pack(atlas, surface->w, surface->h, &rect))
+    {
+        SDL_LogWarn(SDL_LOG_CATEGORY_RENDER,
+                    "Glyph %u is too big for the atlas", ch);
+        SDL_DestroySurface(surface);
+        *glyph = out;
+        return;
+    }
+
+    // The solid surface is paletted with a color key, so we blit it onto a
+    // transparent surface to get the alpha the texture expects.
+    SDL_Surface *rgba =
+        SDL_CreateSurface(surface->w, surface->h, SDL_PIXELFORMAT_RGBA32);
+    if (rgba)
+    {
+        SDL_BlitSurface(surface, NULL, rgba, NULL);
+        SDL_UpdateTexture(atlas->texture, &rect, rgba->pixels, rgba->pitch);
+        SDL_DestroySurface(rgba);
+
+        out.src.x = (float)rect.x;
+        out.src.y = (float)rect.y;
+        out.src.w = (float)rect.w;
+        out.src.h = (float)rect.h;
+    }
+    SDL_DestroySurface(surface);
+    *glyph = out;
+}
+
+/**
+ * Retrieves a glyph from the atlas, rasterizing it the first time it's used.
+ * This may flush the atlas, check `generation` for that.
+ */
+const Glyph *glyph_atlas_get(GlyphAtlas *atlas, TTF_Font *font, Uint32 ch)
+{
+    if (ch < GLYPH_ASCII_COUNT)
+    {
+        Glyph *glyph = &atlas->ascii[ch];
+        if (!glyph->cached)
+            glyph_atlas_rasterize(atlas, font, ch, glyph);
+        return glyph;
+    }
+
+    size_t idx = (size_t)hash_map_get(atlas->others, ch);
+    if (idx > 0)
+        return &atlas->extra[idx - 1];
+
+    // Rasterize it first, as that may flush the atlas and the extra glyphs.
+    Glyph glyph;
+    glyph_atlas_rasterize(atlas, font, ch, &glyph);
+
+    if (atlas->num_extra == atlas->cap_extra)
+    {
+        Uint32 cap = atlas->cap_extra == 0 ? 16 : atlas->cap_extra * 2;
+        Glyph *extra = SDL_realloc(atlas->extra, sizeof(Glyph) * cap);
+        if (!extra)
+            return NULL;
+        atlas->extra = extra;
+        atlas->cap_extra = cap;
+    }
+
+    atlas->extra[atlas->num_extra++] = glyph;
+    hash_map_put(atlas->others, ch, (void *)(size_t)atlas->num_extra);
+    return &atlas->extra[atlas->num_extra - 1];
+}
+
+/**
+ * Destroys the atlas and its texture.
+ */
+void glyph_atlas_destroy(GlyphAtlas *atlas)
+{
+    if (!atlas)
+        return;
+
+    SDL_DestroyTexture(atlas->texture);
+    hash_map_destroy(atlas->others);
+    SDL_free(atlas->extra);
+    SDL_free(atlas);
+}
+
 bool font_eq(Font f1, Font f2)
 {
     return f1.face == f2.face && feqf(f1.sp, f2.sp) && f1.style == f2.style;
@@ -72,13 +315,50 @@ int font_hash(Font font)
  */
 FontNode *font_node_init(Font font, TTF_Font *ttf)
 {
-    FontNode *node = SDL_malloc(sizeof(FontNode));
+    FontNode *node = SDL_calloc(1, sizeof(FontNode));
     node->font = font;
     node->ttf_font = ttf;
-    node->next = NULL;
     return node;
 }
 
+/**
+ * Unlinks a font node from the recently used list.
+ */
+void font_lru_unlink(FontNode *node)
+{
+    if (node->lru_prev)
+        node->lru_prev->lru_next = node->lru_next;
+    else
+        font_lru_head = node->lru_next;
+
+    if (node->lru_next)
+        node->lru_next->lru_prev = node->lru_prev;
+    else
+        font_lru_tail = node->lru_prev;
+
+    node->lru_prev = NULL;
+    node->lru_next = NULL;
+}
+
+/**
+ * Moves a font node to the front of the recently used list.
+ */
+void font_lru_touch(FontNode *node)
+{
+    if (font_lru_head == node)
+        return;
+
+    if (node->lru_prev || node->lru_next || font_lru_tail == node)
+        font_lru_unlink(node);
+
+    node->lru_next = font_lru_head;
+    if (font_lru_head)
+        font_lru_head->lru_prev = node;
+    font_lru_head = node;
+    if (!font_lru_tail)
+        font_lru_tail = node;
+}
+
 /**
  * Retrieves a font node present within the map, if matched the provided font.
  */
@@ -100,48 +380,129 @@ FontNode *font_node_get(Font font)
  * Puts a new font with a TTF font. This replaces the existing node if already
  * there.
  */
-void font_node_put(Font font, TTF_Font *ttf)
+FontNode *font_node_put(Font font, TTF_Font *ttf)
 {
     int idx = font_hash(font);
 
-    // Nothing in that bucket, just smash it in.
-    if (!font_nodes[idx])
-    {
-        font_nodes[idx] = font_node_init(font, ttf);
-        return;
-    }
-
     FontNode *cur = font_nodes[idx];
     while (cur)
     {
         if (font_eq(cur->font, font))
         {
             TTF_CloseFont(cur->ttf_font);
+            glyph_atlas_destroy(cur->atlas);
             cur->ttf_font = ttf;
-            break;
+            cur->atlas = NULL;
+            return cur;
         }
+        cur = cur->next;
+    }
 
-        if (!cur->next)
+    // Not there yet, link it at the front of the bucket.
+    FontNode *node = font_node_init(font, ttf);
+    node->next = font_nodes[idx];
+    font_nodes[idx] = node;
+    num_cached_fonts++;
+    return node;
+}
+
+/**
+ * Closes a font node's font and frees it. The node must be unlinked first.
+ */
+void font_node_free(FontNode *node)
+{
+    TTF_CloseFont(node->ttf_font);
+    glyph_atlas_destroy(node->atlas);
+    SDL_free(node);
+}
+
+void font_node_remove(Font font)
+{
+    int idx = font_hash(font);
+
+    FontNode *prev = NULL;
+    FontNode *cur = font_nodes[idx];
+
+    while (cur)
+    {
+        // We should remove here.
+        if (font_eq(cur->font, font))
         {
-            cur->next = font_node_init(font, ttf);
+            if (prev)
+                prev->next = cur->next;
+            else
+                font_nodes[idx] = cur->next; // It's the head of the list.
+
+            font_lru_unlink(cur);
+            font_node_free(cur);
+            num_cached_fonts--;
             break;
         }
 
+        prev = cur;
         cur = cur->next;
     }
 }
 
+/**
+ * Closes the least recently used fonts until the cache is within its cap.
+ * Fonts that labels still use are skipped, and so is the most recent one, as
+ * it's about to be used.
+ */
+void font_cache_evict(void)
+{
+    FontNode *cur = font_lru_tail;
+    while (cur && cur != font_lru_head && num_cached_fonts > MAX_CACHED_FONTS)
+    {
+        FontNode *prev = cur->lru_prev;
+        if (cur->refs == 0)
+        {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Evicted a cached font style");
+            font_node_remove(cur->font);
+        }
+        cur = prev;
+    }
+}
+
+/**
+ * Opens a font from its face's file in memory, at a size and a style.
+ */
+TTF_Font *font_open(Font font)
+{
+    FontFile *file = &font_files[font.face];
+    TTF_Font *ttf = NULL;
+
+    if (file->data)
+    {
+        SDL_IOStream *io = SDL_IOFromConstMem(file->data, file->size);
+        ttf = io ? TTF_OpenFontIO(io, true, font.sp) : NULL;
+    }
+    else
+    {
+        // The file couldn't be read at startup, try it straight from disk.
+        ttf = TTF_OpenFont(get_font_file_name(font.face), font.sp);
+    }
+
+    if (!ttf)
+        return NULL;
+
+    TTF_SetFontHinting(ttf, TTF_HINTING_LIGHT_SUBPIXEL);
+    TTF_SetFontStyle(ttf, font.style);
+    return ttf;
+}
+
 FontNode *font_node_get_or_create(Font font)
 {
+    if (font.face < 0 || font.face >= NUM_FONT_FACES)
+        return NULL;
+
     FontNode *node = font_node_get(font);
 
     // No cache font. We start to create it.
     if (!node)
     {
-        TTF_Font *ttf = TTF_OpenFont(get_font_file_name(font.face), font.sp);
-        TTF_SetFontHinting(ttf, TTF_HINTING_LIGHT_SUBPIXEL);
-        TTF_SetFontStyle(ttf, font.style);
-
+        TTF_Font *ttf = font_open(font);
         if (!ttf)
         {
             SDL_LogError(SDL_LOG_CATEGORY_RENDER,
@@ -149,54 +510,138 @@ FontNode *font_node_get_or_create(Font font)
             return NULL;
         }
 
-        font_node_put(font, ttf);
-        node = font_node_get(font);
+        node = font_node_put(font, ttf);
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Cached a font style");
     }
 
+    font_lru_touch(node);
+    font_cache_evict();
     return node;
 }
 
-void font_node_remove(Font font)
+void font_node_destroy(FontNode *node)
 {
-    int idx = font_hash(font);
-
-    FontNode *prev = NULL;
-    FontNode *cur = font_nodes[idx];
+    while (node)
+    {
+        FontNode *next = node->next;
+        font_node_free(node);
+        node = next;
+    }
+}
 
-    while (cur)
+bool font_engine_init(AppState *app)
+{
+    for (int i = 0; i < NUM_FONT_FACES; i++)
     {
-        // We should remove here.
-        if (font_eq(cur->font, font))
+        FontFile *file = &font_files[i];
+        file->data =
+            pack_read(get_font_file_name(i), &file->size, &file->owned);
+        if (!file->data)
         {
-            if (prev)
-            {
-                TTF_CloseFont(cur->ttf_font);
-                SDL_free(cur);
-                prev->next = cur->next;
-            }
-            else
-            {
-                // It's the head of the list.
-                SDL_free(cur);
-                font_nodes[idx] = cur->next;
-            }
-            break;
+            SDL_LogError(SDL_LOG_CATEGORY_RENDER,
+                         "Unable to read a font file. %s", SDL_GetError());
         }
+    }
 
-        prev = cur;
-        cur = cur->next;
+    for (size_t i = 0; i < SDL_arraysize(preloaded_fonts); i++)
+        font_node_get_or_create(preloaded_fonts[i]);
+
+    text_engine = TTF_CreateRendererTextEngine(app->window.renderer);
+    if (!text_engine)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_RENDER,
+                     "Unable to create the text engine. %s", SDL_GetError());
+        return false;
     }
+
+    return true;
 }
 
-void font_node_destroy(FontNode *node)
+/**
+ * Makes sure the scratch buffers can hold the provided amount of quads.
+ */
+bool text_reserve_quads(int quads)
 {
-    if (!node)
-        return;
+    if (quads <= text_quad_capacity)
+        return true;
+
+    int cap = SDL_max(quads, text_quad_capacity * 2);
+    SDL_Vertex *vertices =
+        SDL_realloc(text_vertices, sizeof(SDL_Vertex) * 4 * (size_t)cap);
+    if (!vertices)
+        return false;
+    text_vertices = vertices;
+
+    int *indices = SDL_realloc(text_indices, sizeof(int) * 6 * (size_t)cap);
+    if (!indices)
+        return false;
+    text_indices = indices;
+
+    text_quad_capacity = cap;
+    return true;
+}
 
-    TTF_CloseFont(node->ttf_font);
-    font_node_destroy(node->next);
-    SDL_free(node);
+/**
+ * Lays out a string's glyphs as quads into the scratch buffers, with the pen
+ * starting at (0, 0). Returns the amount of quads, or -1 if the atlas got
+ * flushed midway, which invalidates the quads laid out before it.
+ */
+int text_layout_quads(FontNode *node, const char *text, SDL_FColor color,
+                      int *width)
+{
+    GlyphAtlas *atlas = node->atlas;
+    Uint32 generation = atlas->generation;
+
+    const char *cur = text;
+    size_t len = SDL_strlen(text);
+    Uint32 prev = 0;
+    int pen = 0, quads = 0;
+
+    Uint32 ch;
+    while ((ch = SDL_StepUTF8(&cur, &len)) != 0)
+    {
+        const Glyph *glyph = glyph_atlas_get(atlas, node->ttf_font, ch);
+        if (atlas->generation != generation)
+            return -1;
+        if (!glyph)
+            continue;
+
+        int kerning = 0;
+        if (prev && TTF_GetGlyphKerning(node->ttf_font, prev, ch, &kerning))
+            pen += kerning;
+        prev = ch;
+
+        if (glyph->src.w > 0 && text_reserve_quads(quads + 1))
+        {
+            SDL_FRect src = glyph->src;
+            float x0 = (float)pen, y0 = 0;
+            float x1 = x0 + src.w, y1 = src.h;
+            float u0 = src.x / GLYPH_ATLAS_SIZE, v0 = src.y / GLYPH_ATLAS_SIZE;
+            float u1 = (src.x + src.w) / GLYPH_ATLAS_SIZE;
+            float v1 = (src.y + src.h) / GLYPH_ATLAS_SIZE;
+
+            SDL_Vertex *v = &text_vertices[quads * 4];
+            v[0] = (SDL_Vertex){{x0, y0}, color, {u0, v0}};
+            v[1] = (SDL_Vertex){{x1, y0}, color, {u1, v0}};
+            v[2] = (SDL_Vertex){{x1, y1}, color, {u1, v1}};
+            v[3] = (SDL_Vertex){{x0, y1}, color, {u0, v1}};
+
+            int *idx = &text_indices[quads * 6];
+            int base = quads * 4;
+            idx[0] = base;
+            idx[1] = base + 1;
+            idx[2] = base + 2;
+            idx[3] = base;
+            idx[4] = base + 2;
+            idx[5] = base + 3;
+            quads++;
+        }
+
+        pen += glyph->advance;
+    }
+
+    *width = pen;
+    return quads;
 }
 
 void font_engine_render_text(FontRenderingOptions opts)
@@ -206,41 +651,225 @@ void font_engine_render_text(FontRenderingOptions opts)
     FontNode *node = font_node_get_or_create(opts.font);
     SDL_assert(node != NULL);
 
-    // Create the text.
-    SDL_Surface *surface = TTF_RenderText_Solid(
-        node->ttf_font, opts.text, SDL_strlen(opts.text), opts.color);
+    if (!node->atlas)
+        node->atlas = glyph_atlas_init(state->window.renderer);
+    if (!node->atlas)
+        return;
+
+    // Lay out the string. If the atlas was full and got flushed midway, the
+    // second try starts on an empty atlas, so it fits.
+    SDL_FColor color = {
+        .r = opts.color.r / 255.0f,
+        .g = opts.color.g / 255.0f,
+        .b = opts.color.b / 255.0f,
+        .a = opts.color.a / 255.0f,
+    };
+    int width = 0;
+    int quads = text_layout_quads(node, opts.text, color, &width);
+    if (quads < 0)
+        quads = text_layout_quads(node, opts.text, color, &width);
+    if (quads <= 0)
+        return;
 
-    // Calculate the position for the text.
+    // Calculate the position for the text, and move the quads there.
     double x = opts.x, y = opts.y;
-    int w = surface->w, h = surface->h;
-    shift_position_to_origin(opts.origin, &x, &y, w, h);
+    int h = TTF_GetFontHeight(node->ttf_font);
+    shift_position_to_origin(opts.origin, &x, &y, width, h);
+    for (int i = 0; i < quads * 4; i++)
+    {
+        text_vertices[i].position.x += (float)x;
+        text_vertices[i].position.y += (float)y;
+    }
 
-    // Create the surface to render.
-    SDL_Texture *texture =
-        SDL_CreateTextureFromSurface(state->window.renderer, surface);
-    SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_PIXELART);
-    SDL_FRect dstrect = {
+    // The whole string is a single draw call.
+    SDL_RenderGeometry(state->window.renderer, node->atlas->texture,
+                       text_vertices, quads * 4, text_indices, quads * 6);
+}
+
+TextLabel *text_label_init(Font font, const char *text, SDL_Color color)
+{
+    FontNode *node = font_node_get_or_create(font);
+    if (!node)
+        return NULL;
+
+    TTF_Text *ttf_text = TTF_CreateText(text_engine, node->ttf_font, text, 0);
+    if (!ttf_text)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Unable to create text. %s",
+                     SDL_GetError());
+        return NULL;
+    }
+    node->refs++;
+    TTF_SetTextColor(ttf_text, color.r, color.g, color.b, color.a);
+
+    TextLabel *label = SDL_calloc(1, sizeof(TextLabel));
+    label->font = font;
+    label->text = SDL_strdup(text);
+    label->color = color;
+    label->ttf_text = ttf_text;
+    label->dirty = true;
+    return label;
+}
+
+void text_label_set_text(TextLabel *label, const char *text)
+{
+    if (!label || SDL_strcmp(label->text, text) == 0)
+        return;
+
+    SDL_free(label->text);
+    label->text = SDL_strdup(text);
+    TTF_SetTextString(label->ttf_text, text, 0);
+    label->dirty = true;
+}
+
+void text_label_set_font(TextLabel *label, Font font)
+{
+    if (!label || font_eq(label->font, font))
+        return;
+
+    FontNode *node = font_node_get_or_create(font);
+    if (!node)
+        return;
+    node->refs++;
+
+    FontNode *old = font_node_get(label->font);
+    if (old)
+        old->refs--;
+
+    label->font = font;
+    TTF_SetTextFont(label->ttf_text, node->ttf_font);
+    label->dirty = true;
+}
+
+void text_label_set_color(TextLabel *label, SDL_Color color)
+{
+    if (!label)
+        return;
+
+    SDL_Color cur = label->color;
+    if (cur.r == color.r && cur.g == color.g && cur.b == color.b &&
+        cur.a == color.a)
+        return;
+
+    label->color = color;
+    TTF_SetTextColor(label->ttf_text, color.r, color.g, color.b, color.a);
+    label->dirty = true;
+}
+
+/**
+ * Rasterizes the label into its texture. The texture is only recreated if the
+ * size of the text changed.
+ */
+void text_label_rasterize(TextLabel *label, SDL_Renderer *renderer)
+{
+    int w = 0, h = 0;
+    TTF_GetTextSize(label->ttf_text, &w, &h);
+    if (w <= 0 || h <= 0)
+    {
+        // Nothing to draw, like an empty string.
+        SDL_DestroyTexture(label->texture);
+        label->texture = NULL;
+        label->w = label->h = 0;
+        return;
+    }
+
+    if (!label->texture || label->w != w || label->h != h)
+    {
+        SDL_DestroyTexture(label->texture);
+        label->texture =
+            SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                              SDL_TEXTUREACCESS_TARGET, w, h);
+        if (!label->texture)
+        {
+            SDL_LogError(SDL_LOG_CATEGORY_RENDER,
+                         "Unable to create a text texture. %s",
+                         SDL_GetError());
+            label->w = label->h = 0;
+            return;
+        }
+
+        // Blending the text onto a transparent texture leaves its colors
+        // premultiplied by alpha, so it has to be drawn that way too.
+        SDL_SetTextureBlendMode(label->texture,
+                                SDL_BLENDMODE_BLEND_PREMULTIPLIED);
+        SDL_SetTextureScaleMode(label->texture, SDL_SCALEMODE_PIXELART);
+        label->w = w;
+        label->h = h;
+    }
+
+    SDL_Texture *prev = SDL_GetRenderTarget(renderer);
+    SDL_SetRenderTarget(renderer, label->texture);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    TTF_DrawRendererText(label->ttf_text, 0, 0);
+    SDL_SetRenderTarget(renderer, prev);
+}
+
+void text_label_render(TextLabel *label, double x, double y,
+                       RenderingOriginType origin)
+{
+    if (!label)
+        return;
+
+    SDL_Renderer *renderer = app_get()->window.renderer;
+    if (label->dirty)
+    {
+        text_label_rasterize(label, renderer);
+        label->dirty = false;
+    }
+
+    if (!label->texture)
+        return;
+
+    shift_position_to_origin(origin, &x, &y, label->w, label->h);
+    SDL_FRect dst = {
         .x = (float)x,
         .y = (float)y,
-        .h = (float)h,
-        .w = (float)w,
+        .w = (float)label->w,
+        .h = (float)label->h,
     };
-    SDL_RenderTexture(state->window.renderer, texture, NULL, &dstrect);
+    SDL_RenderTexture(renderer, label->texture, NULL, &dst);
+}
 
-    SDL_DestroySurface(surface);
-    SDL_DestroyTexture(texture);
+void text_label_destroy(TextLabel *label)
+{
+    if (!label)
+        return;
+
+    FontNode *node = font_node_get(label->font);
+    if (node)
+        node->refs--;
+
+    TTF_DestroyText(label->ttf_text);
+    SDL_DestroyTexture(label->texture);
+    SDL_free(label->text);
+    SDL_free(label);
 }
 
 void font_engine_destroy(void)
 {
     for (int i = 0; i < MAX_FONT_NODES; i++)
     {
-        if (font_nodes[i])
-        {
-            font_node_destroy(font_nodes[i]);
-        }
+        font_node_destroy(font_nodes[i]);
+        font_nodes[i] = NULL;
+    }
+    font_lru_head = NULL;
+    font_lru_tail = NULL;
+    num_cached_fonts = 0;
+
+    for (int i = 0; i < NUM_FONT_FACES; i++)
+    {
+        if (font_files[i].owned)
+            SDL_free(font_files[i].data);
+        font_files[i] = (FontFile){0};
     }
 
     TTF_DestroyRendererTextEngine(text_engine);
     text_engine = NULL;
+
+    SDL_free(text_vertices);
+    SDL_free(text_indices);
+    text_vertices = NULL;
+    text_indices = NULL;
+    text_quad_capacity = 0;
 }
@@ -1,6 +1,7 @@
 #include "SDL3/SDL_pixels.h"
 #include "SDL3/SDL_rect.h"
 #include "SDL3/SDL_render.h"
+#include "app.h"
 #include "engine/scene.h"
 #include "game/game_scenes.h"
 
@@ -13,7 +14,30 @@ void scene_empty_ondraw(Scene *scene, SDL_Renderer *renderer)
 
     // Draw the rectangle with the specified color and alpha
     SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    SDL_RenderClear(renderer);
+    SDL_RenderFillRect(renderer, &scene->data.empty.frect);
+}
+
+/**
+ * Checks if the scene's rectangle hides every scene below it.
+ */
+bool scene_empty_is_opaque(const Scene *scene, int w, int h)
+{
+    SDL_Color color = scene->data.empty.color;
+    SDL_FRect frect = scene->data.empty.frect;
+    return color.a == 255 && frect.x <= 0 && frect.y <= 0 &&
+           frect.x + frect.w >= (float)w && frect.y + frect.h >= (float)h;
+}
+
+void scene_empty_onresize(Scene *scene, int w, int h)
+{
+    if (scene->id != SCENE_ID_EMPTY)
+        return;
+
+    // A rectangle made to fill the screen keeps filling it.
+    if (scene->data.empty.fills_screen)
+        scene->data.empty.frect = (SDL_FRect){0, 0, (float)w, (float)h};
+
+    scene->opaque = scene_empty_is_opaque(scene, w, h);
 }
 
 Scene *scene_empty_init(SDL_Color color, SDL_FRect frect)
@@ -24,7 +48,15 @@ Scene *scene_empty_init(SDL_Color color, SDL_FRect frect)
     scene->data.empty.frect = frect;
     scene->enabled = true;
 
+    // A solid color over the whole screen hides every scene below it.
+    WindowStatus win = app_get()->window;
+    scene->data.empty.fills_screen =
+        frect.x == 0 && frect.y == 0 && frect.w == (float)win.logical_w &&
+        frect.h == (float)win.logical_h;
+    scene->opaque = scene_empty_is_opaque(scene, win.logical_w, win.logical_h);
+
     scene->ondraw = scene_empty_ondraw;
+    scene->onresize = scene_empty_onresize;
 
     return scene;
 }
@@ -1,10 +1,44 @@
 #include "SDL3/SDL_stdinc.h"
 #include "SDL3_ttf/SDL_ttf.h"
 #include "app.h"
+#include "engine/assets.h"
 #include "engine/renderer.h"
+#include "engine/sprite.h"
 #include "engine/text.h"
 #include "game/game_scenes.h"
 
+// The assets the FPS scene needs, loaded before it starts.
+static const AssetRef scene_fps_assets[] = {
+    {ASSET_TYPE_SPRITE, "sakura"},
+};
+
+void scene_fps_oninit(Scene *scene)
+{
+    // The sheet was preloaded with the scene, so this doesn't touch the disk.
+    scene->data.fps.mascot = sprite_init("sakura");
+    if (scene->data.fps.mascot)
+        scene->data.fps.mascot->anim.playing = true;
+}
+
+void scene_fps_ontick(Scene *scene, double dt)
+{
+    Sprite *mascot = scene->data.fps.mascot;
+    if (mascot && sprite_advance_animation(mascot, dt))
+        scene_mark_dirty(scene);
+
+    // The counter only changes once a second, so only redraw then.
+    Uint32 fps = app_get()->frame_data.fps;
+    if (scene->data.fps.shown_fps != fps)
+    {
+        scene->data.fps.shown_fps = fps;
+
+        char buf[16];
+        SDL_snprintf(buf, sizeof(buf), "%u FPS", fps);
+        text_label_set_text(scene->data.fps.label, buf);
+        scene_mark_dirty(scene);
+    }
+}
+
 void scene_fps_ondraw(Scene *scene, SDL_Renderer *renderer)
 {
     (void)renderer;
@@ -12,24 +46,29 @@ void scene_fps_ondraw(Scene *scene, SDL_Renderer *renderer)
     if (scene->id != SCENE_ID_FPS)
         return;
 
-    AppState *appstate = app_get();
-    WindowStatus win = appstate->window;
-
-    char buf[10];
-    SDL_snprintf(buf, 10, "%d FPS", appstate->frame_data.fps);
-    font_engine_render_text((FontRenderingOptions){
-        .color = scene->data.empty.color,
-        .origin = RENDER_ORIGIN_TOP_RIGHT,
-        .text = buf,
-        .x = win.w - 10,
-        .y = 10,
-        .font =
-            {
-                .face = FONT_FACE_DAYDREAM,
-                .sp = 24,
-                .style = TTF_STYLE_NORMAL,
-            },
-    });
+    WindowStatus win = app_get()->window;
+    text_label_render(scene->data.fps.label, win.logical_w - 5, 5,
+                      RENDER_ORIGIN_TOP_RIGHT);
+
+    // The mascot sits in the bottom left corner.
+    Sprite *mascot = scene->data.fps.mascot;
+    if (mascot)
+    {
+        const SpriteFrame *frame = sprite_current_frame(mascot);
+        Vector2 pos = {
+            .x = 5 + frame->frame.w / 2,
+            .y = win.logical_h - 5 - frame->frame.h / 2,
+        };
+        render_sprite(mascot, pos);
+    }
+}
+
+void scene_fps_ondestroy(Scene *scene)
+{
+    text_label_destroy(scene->data.fps.label);
+    scene->data.fps.label = NULL;
+    sprite_destroy(scene->data.fps.mascot);
+    scene->data.fps.mascot = NULL;
 }
 
 Scene *scene_fps_init(SDL_Color color)
@@ -37,9 +76,22 @@ Scene *scene_fps_init(SDL_Color color)
     Scene *scene = scene_init();
     scene->id = SCENE_ID_FPS;
     scene->data.fps.color = color;
+    scene->data.fps.label = text_label_init(
+        (Font){
+            .face = FONT_FACE_DAYDREAM,
+            .sp = 12,
+            .style = TTF_STYLE_NORMAL,
+        },
+        "0 FPS", color);
+    scene->data.fps.mascot = NULL;
     scene->enabled = true;
+    scene->assets = scene_fps_assets;
+    scene->num_assets = SDL_arraysize(scene_fps_assets);
 
+    scene->oninit = scene_fps_oninit;
+    scene->ontick = scene_fps_ontick;
     scene->ondraw = scene_fps_ondraw;
+    scene->ondestroy = scene_fps_ondestroy;
 
     return scene;
 }
@@ -0,0 +1,49 @@
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_rect.h"
+#include "SDL3/SDL_render.h"
+#include "app.h"
+#include "engine/scene.h"
+#include "game/game_scenes.h"
+
+#define SCENE_LOADING_BAR_WIDTH 120
+#define SCENE_LOADING_BAR_HEIGHT 6
+
+void scene_loading_ondraw(Scene *scene, SDL_Renderer *renderer)
+{
+    if (scene->id != SCENE_ID_LOADING)
+        return;
+
+    SDL_Color color = scene->data.loading.color;
+    WindowStatus win = app_get()->window;
+
+    // The bar sits at the bottom right, out of the way of the scene below.
+    SDL_FRect frame = {
+        .x = (float)(win.logical_w - SCENE_LOADING_BAR_WIDTH - 8),
+        .y = (float)(win.logical_h - SCENE_LOADING_BAR_HEIGHT - 8),
+        .w = SCENE_LOADING_BAR_WIDTH,
+        .h = SCENE_LOADING_BAR_HEIGHT,
+    };
+    SDL_FRect fill = {
+        .x = frame.x + 1,
+        .y = frame.y + 1,
+        .w = (frame.w - 2) * scene->data.loading.progress,
+        .h = frame.h - 2,
+    };
+
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+    SDL_RenderRect(renderer, &frame);
+    SDL_RenderFillRect(renderer, &fill);
+}
+
+Scene *scene_loading_init(SDL_Color color)
+{
+    Scene *scene = scene_init();
+    scene->id = SCENE_ID_LOADING;
+    scene->data.loading.color = color;
+    scene->data.loading.progress = 0;
+    scene->enabled = true;
+
+    scene->ondraw = scene_loading_ondraw;
+
+    return scene;
+}
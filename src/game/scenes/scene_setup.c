@@ -29,10 +29,14 @@ void scene_setup(void)
     SDL_FRect frect = {
         .x = 0,
         .y = 0,
-        .w = app->window.w,
-        .h = app->window.h,
+        .w = app->window.logical_w,
+        .h = app->window.logical_h,
     };
 
+    // Shown by the scene manager whenever a scene takes long to load.
+    app->scene_mgr.loading =
+        scene_loading_init((SDL_Color){.r = 50, .g = 50, .b = 200, .a = 255});
+
     // Here we want to setup a few scenes.
     Scene *empty = scene_empty_init(white, frect);
     scene_mgr_push_scene(&app->scene_mgr, empty);
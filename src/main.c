@@ -80,6 +80,7 @@ SDL_AppResult SDL_AppIterate(void *appstate)
 
     engine_iterate(state);
     engine_render(state);
+    engine_wait_frame(state);
 
     return SDL_APP_CONTINUE;
 }
@@ -103,6 +104,9 @@ void SDL_AppQuit(void *appstate, SDL_AppResult result)
 {
     AppState *app = (AppState *)appstate;
 
+    if (APP_INIT_SUCCESS)
+        app_destroy_scenes(app);
+
     if (ENGINE_INIT_SUCCESS)
         engine_destroy();
 
@@ -0,0 +1,44 @@
+#include "misc/array.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_stdinc.h"
+
+// The smallest capacity an array grows to.
+#define ARRAY_MIN_CAPACITY 8
+
+void *array_grow(void *items, Uint32 length, Uint32 needed, size_t size,
+                 Uint32 *capacity, bool *fixed)
+{
+    if (needed <= *capacity)
+        return items;
+
+    // Doubling keeps adding a value amortized constant.
+    Uint32 new_capacity =
+        SDL_max(SDL_max(needed, *capacity * 2), ARRAY_MIN_CAPACITY);
+    void *new_items = *fixed ? SDL_malloc(new_capacity * size)
+                             : SDL_realloc(items, new_capacity * size);
+    if (!new_items)
+    {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Reallocation for array failed.");
+        return items;
+    }
+
+    // The inline room stays where it is, the values move out of it.
+    if (*fixed && length > 0)
+        SDL_memcpy(new_items, items, length * size);
+
+    *capacity = new_capacity;
+    *fixed = false;
+    return new_items;
+}
+
+bool array_insert_check(Uint32 length, Uint32 idx)
+{
+    return idx <= length;
+}
+
+void array_release(void *items, bool fixed)
+{
+    if (!fixed)
+        SDL_free(items);
+}
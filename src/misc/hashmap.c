@@ -1,10 +1,12 @@
 #include "misc/hashmap.h"
 #include "SDL3/SDL_assert.h"
+#include "SDL3/SDL_log.h"
 #include "SDL3/SDL_stdinc.h"
 
-static inline Uint32 hash_uint32(Uint32 key)
+static inline Uint32 hash_uint32(Uint32 key, Uint32 capacity)
 {
-    return (key * 2654435761u) % HASH_MAP_MAX_BUCKETS;
+    Uint32 hash = key * 2654435761u;
+    return (hash ^ (hash >> 16)) & (capacity - 1);
 }
 
 HashMap *hash_map_init(void)
@@ -14,112 +16,155 @@ HashMap *hash_map_init(void)
     return map;
 }
 
-bool hash_map_has_key(HashMap *map, Uint32 key)
+/**
+ * Finds the entry of a key. Returns NULL if there's none.
+ */
+HashMapEntry *hash_map_find(HashMap *map, Uint32 key)
 {
-    return hash_map_get(map, key) != NULL;
+    if (!map->entries)
+        return NULL;
+
+    Uint32 idx = hash_uint32(key, map->capacity);
+    for (Uint32 dist = 1;; dist++)
+    {
+        HashMapEntry *entry = &map->entries[idx];
+
+        // Entries are sorted by how far they are from their ideal slot. Once
+        // they are closer than the key would be, the key isn't here.
+        if (entry->dist < dist)
+            return NULL;
+        if (entry->key == key)
+            return entry;
+
+        idx = (idx + 1) & (map->capacity - 1);
+    }
 }
 
-bool hash_map_has_value(HashMap *map, void *value)
+/**
+ * Places an entry of a new key. Entries further from their ideal slot take
+ * the place of the ones that are closer, and those move on.
+ */
+void hash_map_place(HashMap *map, HashMapEntry entry)
 {
-    for (int i = 0; i < HASH_MAP_MAX_BUCKETS; ++i)
+    Uint32 idx = hash_uint32(entry.key, map->capacity);
+    entry.dist = 1;
+
+    for (;;)
     {
-        HashMapNode *node = map->nodes[i];
-        while (node)
+        HashMapEntry *cur = &map->entries[idx];
+        if (cur->dist == 0)
+        {
+            *cur = entry;
+            return;
+        }
+        if (cur->dist < entry.dist)
         {
-            if (node->value == value)
-            {
-                return true;
-            }
-            node = node->next;
+            HashMapEntry swap = *cur;
+            *cur = entry;
+            entry = swap;
         }
+
+        idx = (idx + 1) & (map->capacity - 1);
+        entry.dist++;
     }
-    return false;
 }
 
-void *hash_map_put(HashMap *map, Uint32 key, void *value)
+/**
+ * Doubles the capacity of the map, and places every entry again.
+ */
+bool hash_map_grow(HashMap *map)
 {
-    Uint32 idx = hash_uint32(key);
-    HashMapNode *prev = NULL;
-    HashMapNode *cur = map->nodes[idx];
-
-    while (cur)
+    Uint32 capacity = SDL_max(map->capacity * 2, HASH_MAP_MIN_CAPACITY);
+    HashMapEntry *entries = SDL_calloc(capacity, sizeof(HashMapEntry));
+    if (!entries)
     {
-        // Replacement.
-        if (cur->key == key)
-        {
-            void *ret = cur->value;
-            cur->value = value;
-            return ret;
-        }
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Reallocation for hash map failed.");
+        return false;
+    }
 
-        prev = cur;
-        cur = cur->next;
+    HashMapEntry *old = map->entries;
+    Uint32 old_capacity = map->capacity;
+    map->entries = entries;
+    map->capacity = capacity;
+
+    for (Uint32 i = 0; i < old_capacity; i++)
+    {
+        if (old[i].dist)
+            hash_map_place(map, old[i]);
     }
 
-    // That key doesn't exist yet.
-    HashMapNode *node = SDL_malloc(sizeof(HashMapNode));
-    node->key = key;
-    node->value = value;
-    node->next = NULL;
-    if (prev)
+    SDL_free(old);
+    return true;
+}
+
+bool hash_map_has_key(HashMap *map, Uint32 key)
+{
+    return hash_map_find(map, key) != NULL;
+}
+
+bool hash_map_has_value(HashMap *map, void *value)
+{
+    for (Uint32 i = 0; i < map->capacity; i++)
     {
-        // The chain is already started.
-        prev->next = node;
+        if (map->entries[i].dist && map->entries[i].value == value)
+            return true;
     }
-    else
+    return false;
+}
+
+void *hash_map_put(HashMap *map, Uint32 key, void *value)
+{
+    // Replacement.
+    HashMapEntry *entry = hash_map_find(map, key);
+    if (entry)
     {
-        // The chain doesn't exist yet.
-        map->nodes[idx] = node;
+        void *ret = entry->value;
+        entry->value = value;
+        return ret;
     }
 
+    // That key doesn't exist yet.
+    if ((map->size + 1) * 4 > map->capacity * HASH_MAP_MAX_LOAD &&
+        !hash_map_grow(map))
+        return NULL;
+
+    hash_map_place(map, (HashMapEntry){.key = key, .value = value});
     map->size++;
     return NULL;
 }
 
 void *hash_map_remove(HashMap *map, Uint32 key)
 {
-    Uint32 idx = hash_uint32(key);
-    HashMapNode *prev = NULL;
-    HashMapNode *cur = map->nodes[idx];
+    HashMapEntry *entry = hash_map_find(map, key);
+    if (!entry)
+        return NULL;
+
+    void *ret = entry->value;
 
-    while (cur)
+    // Shift the entries after it back, until one is already in its ideal
+    // slot, so there's never a hole in the middle of a probe.
+    Uint32 idx = (Uint32)(entry - map->entries);
+    for (;;)
     {
-        // Remove existing node.
-        if (cur->key == key)
-        {
-            // Depends on whether it's a start of a chain or a inner node.
-            if (prev)
-            {
-                prev->next = cur->next;
-            }
-            else
-            {
-                map->nodes[idx] = cur->next;
-            }
-
-            void *ret = cur->value;
-            SDL_free(cur);
-            map->size--;
-            return ret;
-        }
+        Uint32 next = (idx + 1) & (map->capacity - 1);
+        if (map->entries[next].dist <= 1)
+            break;
 
-        prev = cur;
-        cur = cur->next;
+        map->entries[idx] = map->entries[next];
+        map->entries[idx].dist--;
+        idx = next;
     }
 
-    return NULL;
+    map->entries[idx] = (HashMapEntry){0};
+    map->size--;
+    return ret;
 }
 
 void *hash_map_get(HashMap *map, Uint32 key)
 {
-    HashMapNode *cur = map->nodes[hash_uint32(key)];
-    while (cur)
-    {
-        if (cur->key == key)
-            return cur->value;
-        cur = cur->next;
-    }
-    return NULL;
+    HashMapEntry *entry = hash_map_find(map, key);
+    return entry ? entry->value : NULL;
 }
 
 void hash_map_iterate(HashMap *map, Uint32 *keys, void **values)
@@ -127,38 +172,24 @@ void hash_map_iterate(HashMap *map, Uint32 *keys, void **values)
     SDL_assert(keys != NULL && values != NULL);
 
     Uint32 idx = 0;
-    for (int i = 0; i < HASH_MAP_MAX_BUCKETS; i++)
+    for (Uint32 i = 0; i < map->capacity; i++)
     {
-        HashMapNode *node = map->nodes[idx];
-        while (node)
-        {
-            keys[idx] = node->key;
-            values[idx] = node->value;
-            idx++;
-            node = node->next;
-        }
+        if (!map->entries[i].dist)
+            continue;
+
+        keys[idx] = map->entries[i].key;
+        values[idx] = map->entries[i].value;
+        idx++;
     }
 
     SDL_assert(idx == map->size);
 }
 
-void map_node_destroy(HashMapNode *node)
-{
-    while (node)
-    {
-        HashMapNode *next = node->next;
-        SDL_free(node);
-        node = next;
-    }
-}
-
 void hash_map_clear(HashMap *map)
 {
-    for (int i = 0; i < HASH_MAP_MAX_BUCKETS; i++)
-    {
-        map_node_destroy(map->nodes[i]);
-        map->nodes[i] = NULL;
-    }
+    // The entries are kept, the map will likely fill up again.
+    if (map->entries)
+        SDL_memset(map->entries, 0, map->capacity * sizeof(HashMapEntry));
 
     map->size = 0;
 }
@@ -168,6 +199,6 @@ void hash_map_destroy(HashMap *map)
     if (!map)
         return;
 
-    hash_map_clear(map);
+    SDL_free(map->entries);
     SDL_free(map);
 }
@@ -38,7 +38,7 @@ void list_shrink(List *list)
 
 void list_add(List *list, void *item)
 {
-    if (list->length + 1 <= list->capacity)
+    if (list->length == list->capacity)
         list_expand(list);
     list->items[list->length++] = item;
 }
@@ -47,10 +47,9 @@ void list_add_at(List *list, void *item, Uint32 k)
 {
     if (k >= list->length)
         return;
-    if (list->length + 1 <= list->capacity)
+    if (list->length == list->capacity)
         list_expand(list);
 
-    list_expand(list);
     SDL_memmove(list->items + k + 1, list->items + k,
                 sizeof(void *) * (list->length - k));
     list->items[k] = item;
@@ -1,5 +1,11 @@
 # This is a tool-file, meant to transform the provided level text file
 # into a .map file for easier loading in game.
+#
+# With --v2, the map is written in the version 2 format instead. After a 28
+# bytes header (version, width, height, chunk size, name length, name offset
+# and chunk index offset), the tiles are split in square chunks. The index has
+# an entry per chunk, row by row: the offset and size of its data, and how it
+# is stored, as nothing (only air), a byte per tile, or (run, tile) byte pairs.
 
 import os
 import sys
@@ -9,6 +15,10 @@ from math import isnan
 from typing import IO
 
 TOOL_VERSION = 1
+CHUNK_SIZE = 32
+CHUNK_EMPTY = 0
+CHUNK_RAW = 1
+CHUNK_RLE = 2
 
 def split_coords(coord):
     m = re.match(r"(\d+),(\d+)", coord)
@@ -68,7 +78,7 @@ def parse_meta_region(map: dict, f: IO):
     f.write(struct.pack("<I", len(name)))
     f.write(struct.pack(f"{len(name)}s", bytearray(name, 'utf-8')))
 
-def parse_map_region(map: dict, f: IO):
+def collect_coords(map: dict):
     # Get out the coords
     coords_list = []
     max = (0, 0)
@@ -91,9 +101,14 @@ def parse_map_region(map: dict, f: IO):
             max_y = y
         max = (max_x, max_y)
 
+    return coords_list, (max[0] + 1, max[1] + 1)
+
+def parse_map_region(map: dict, f: IO):
+    coords_list, size = collect_coords(map)
+
     # Write the max size of the grid first
-    f.write(struct.pack("<I", max[0] + 1))
-    f.write(struct.pack("<I", max[1] + 1))
+    f.write(struct.pack("<I", size[0]))
+    f.write(struct.pack("<I", size[1]))
 
     # Then write the length of coords.
     f.write(struct.pack("<I", len(coords_list)))
@@ -105,21 +120,86 @@ def parse_map_region(map: dict, f: IO):
         f.write(struct.pack("<I", v))
     print(f"Written {len(coords_list)} coords")
 
+def encode_rle(tiles: bytes):
+    out = bytearray()
+    i = 0
+    while i < len(tiles):
+        run = 1
+        while i + run < len(tiles) and run < 255 and tiles[i + run] == tiles[i]:
+            run += 1
+        out += bytes([run, tiles[i]])
+        i += run
+    return bytes(out)
+
+def encode_chunk(grid: list[bytearray], x: int, y: int):
+    w = min(CHUNK_SIZE, len(grid[0]) - x)
+    h = min(CHUNK_SIZE, len(grid) - y)
+    tiles = b"".join(bytes(grid[row][x:x + w]) for row in range(y, y + h))
+
+    if not any(tiles):
+        return CHUNK_EMPTY, b""
+
+    rle = encode_rle(tiles)
+    if len(rle) < len(tiles):
+        return CHUNK_RLE, rle
+    return CHUNK_RAW, tiles
+
+def write_v2(map: dict, f: IO):
+    name = bytearray(map["meta.name"], 'utf-8')
+    if not name:
+        print("name missing in meta region")
+        sys.exit(1)
+
+    coords_list, (w, h) = collect_coords(map)
+    grid = [bytearray(w) for _ in range(h)]
+    for x, y, v in coords_list:
+        if v < 0 or v > 255:
+            print(f"Invalid tile {v} at {x},{y}")
+            sys.exit(1)
+        grid[y][x] = v
+
+    chunks = []
+    for y in range(0, h, CHUNK_SIZE):
+        for x in range(0, w, CHUNK_SIZE):
+            chunks.append(encode_chunk(grid, x, y))
+
+    name_at = 28
+    chunks_at = name_at + len(name)
+    data_at = chunks_at + 12 * len(chunks)
+
+    print(f"Writing map {name.decode('utf-8')}")
+    f.write(struct.pack("<7I", 2, w, h, CHUNK_SIZE, len(name), name_at, chunks_at))
+    f.write(name)
+    for encoding, data in chunks:
+        f.write(struct.pack("<3I", data_at, len(data), encoding))
+        data_at += len(data)
+    for _, data in chunks:
+        f.write(data)
+    print(f"Written {len(coords_list)} coords in {len(chunks)} chunks")
+
 def main():
-    if len(sys.argv) < 2:
-        print("Not enough arguments. Use python map_to_bin.py levelfile")
+    args = [arg for arg in sys.argv[1:] if arg != "--v2"]
+    use_v2 = len(args) != len(sys.argv) - 1
+
+    if len(args) < 1:
+        print("Not enough arguments. Use python map_to_bin.py [--v2] levelfile")
         return
 
     try:
-        with open(sys.argv[1], 'r') as f:
+        with open(args[0], 'r') as f:
             lines = [l.strip() for l in f.readlines() if not l.startswith("#")]
-            sprname, _ = os.path.splitext(sys.argv[1])
+            sprname, _ = os.path.splitext(args[0])
 
         # Open a new file for writing at the same path of the provided sheet
         outpath = f"{sprname}.map"
         print(outpath)
         with open(outpath, 'wb') as f:
             groups = partition(lines)
+            if use_v2:
+                print("Using v2 of map_to_bin.")
+                write_v2(groups, f)
+                return
+
             f.write(struct.pack("<I", TOOL_VERSION))
             print(f"Using v{TOOL_VERSION} of map_to_bin.")
             parse_meta_region(groups, f)
@@ -0,0 +1,90 @@
+# This is a tool-file, meant to bundle every file of the assets directory into
+# a single assets.pack file, that the game maps into memory at startup.
+#
+# The pack starts with a header: the "SAKP" magic, the version, the number of
+# files and the offset of the names. Then comes the table of contents, sorted
+# by path, with one entry per file: the offset and length of its path within
+# the names, then the offset and size of its content. The names follow, then
+# the content of every file, each aligned to 16 bytes.
+
+import os
+import sys
+import struct
+
+
+TOOL_VERSION = 1
+HEADER_SIZE = 16
+ENTRY_SIZE = 24
+ALIGNMENT = 16
+
+
+def align(n, to):
+    return (n + to - 1) // to * to
+
+
+def collect(assets_dir):
+    # Paths are stored as the game asks for them, like "assets/spr/tile.sprite".
+    root = os.path.dirname(os.path.abspath(assets_dir))
+    files = []
+    for dirpath, _, filenames in os.walk(assets_dir):
+        for filename in filenames:
+            full = os.path.join(dirpath, filename)
+            rel = os.path.relpath(os.path.abspath(full), root).replace(os.sep, "/")
+            files.append((rel.encode("utf-8"), full))
+
+    # Sorted by the raw bytes, so the game can binary search them.
+    files.sort(key=lambda f: f[0])
+    return files
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("This program requires at least 1 argument. Use pack_assets.py assets_dir [output.pack]")
+        sys.exit(1)
+
+    assets_dir = sys.argv[1]
+    outpath = sys.argv[2] if len(sys.argv) > 2 else "assets.pack"
+    print(f"You have selected the assets directory to be \"{assets_dir}\"")
+
+    try:
+        files = collect(assets_dir)
+
+        names = b""
+        name_offsets = []
+        for name, _ in files:
+            name_offsets.append(len(names))
+            names += name + b"\0"
+
+        names_at = HEADER_SIZE + ENTRY_SIZE * len(files)
+        data_at = align(names_at + len(names), ALIGNMENT)
+
+        entries = b""
+        contents = []
+        for (name, full), name_at in zip(files, name_offsets):
+            with open(full, "rb") as f:
+                content = f.read()
+            entries += struct.pack("<IIQQ", name_at, len(name), data_at, len(content))
+            contents.append((data_at, content))
+            data_at = align(data_at + len(content), ALIGNMENT)
+
+        with open(outpath, "wb") as f:
+            print(f"Using v{TOOL_VERSION} of pack_assets")
+            f.write(b"SAKP")
+            f.write(struct.pack("<III", TOOL_VERSION, len(files), names_at))
+            f.write(entries)
+            f.write(names)
+
+            for offset, content in contents:
+                f.write(b"\0" * (offset - f.tell()))
+                f.write(content)
+
+        for name, _ in files:
+            print(f"Packed {name.decode('utf-8')}")
+        print(f"Written {len(files)} files to {outpath}")
+    except OSError:
+        print("An error occurred while reading the assets")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -9,17 +9,86 @@ import struct
 
 TOOL_VERSION = 1
 
+# Version 2 stores the pixels decoded, in RGBA order, with fixed-size tables
+# for the frames and tags. The header is the version, width, height, pitch,
+# number of frames, number of tags, then the offsets of the frames table, the
+# tags table, the tag names and the pixels.
+TOOL_VERSION_V2 = 2
+V2_HEADER_SIZE = 40
+V2_FRAME_SIZE = 44
+V2_TAG_SIZE = 16
+
+
+def align(n, to):
+    return (n + to - 1) // to * to
+
+
+def write_v2(outpath, sprsheet, data):
+    # Pillow is only needed to decode the sheet for version 2.
+    from PIL import Image
+
+    img = Image.open(sprsheet).convert("RGBA")
+    w, h = img.size
+    pixels = img.tobytes()
+    pitch = w * 4
+
+    frame_tags = data['meta']['frameTags']
+    frames = data['frames']
+
+    names = b""
+    tag_records = b""
+    for tag in frame_tags:
+        name = bytes(tag['name'], 'utf-8')
+        tag_records += struct.pack("<IIII", len(names), len(name), tag['from'], tag['to'])
+        names += name
+
+    frame_records = b""
+    for frame in frames:
+        frame_records += struct.pack(
+            "<11I",
+            frame["sourceSize"]["w"],
+            frame["sourceSize"]["h"],
+            frame["spriteSourceSize"]["x"],
+            frame["spriteSourceSize"]["y"],
+            frame["spriteSourceSize"]["w"],
+            frame["spriteSourceSize"]["h"],
+            frame["frame"]["x"],
+            frame["frame"]["y"],
+            frame["frame"]["w"],
+            frame["frame"]["h"],
+            frame["duration"],
+        )
+
+    frames_at = V2_HEADER_SIZE
+    tags_at = frames_at + len(frame_records)
+    names_at = tags_at + len(tag_records)
+    pixels_at = align(names_at + len(names), 16)
+
+    with open(outpath, 'wb') as f:
+        print(f"Using v{TOOL_VERSION_V2} of sprite_to_bin")
+        f.write(struct.pack("<10I", TOOL_VERSION_V2, w, h, pitch, len(frames),
+                            len(frame_tags), frames_at, tags_at, names_at, pixels_at))
+        f.write(frame_records)
+        f.write(tag_records)
+        f.write(names)
+        f.write(b"\0" * (pixels_at - names_at - len(names)))
+        f.write(pixels)
+        print(f"Written {len(frames)} frames, {len(frame_tags)} tags and {w}x{h} pixels")
+
 
 def main():
-    if len(sys.argv) < 3:
-        print("This program requires 2 arguments. Use sprite_to_bin.py spritesheet.png spritedata.json")
+    args = [arg for arg in sys.argv[1:] if arg != "--v2"]
+    use_v2 = len(args) != len(sys.argv) - 1
+
+    if len(args) < 2:
+        print("This program requires 2 arguments. Use sprite_to_bin.py [--v2] spritesheet.png spritedata.json")
         return
 
-    if len(sys.argv) > 3:
-        print(f"There are more arguments than required. Ignoring {sys.argv[3:]}")
+    if len(args) > 2:
+        print(f"There are more arguments than required. Ignoring {args[2:]}")
 
-    sprsheet = sys.argv[1]
-    sprdata = sys.argv[2]
+    sprsheet = args[0]
+    sprdata = args[1]
     print(f"You have selected the sprite sheet to be \"{sprsheet}\"")
     print(f"You have selected the sprite data to be \"{sprdata}\"")
 
@@ -32,6 +101,10 @@ def main():
         print(sprname)
         outpath = f"{sprname}.sprite"
 
+        if use_v2:
+            write_v2(outpath, sprsheet, data)
+            return
+
         with open(outpath, 'wb') as f:
             print(f"Using v{TOOL_VERSION} of sprite_to_bin")
             f.write(struct.pack("<I", TOOL_VERSION))